@@ -0,0 +1,604 @@
+/**
+ * kernel/bench.c - 内核内置基准测试
+ *
+ * bench_pmm_fragmentation:
+ *   在同一条随机分配/释放序列上对比两种分配器：
+ *   - stack：旧的栈式分配器模型（LIFO，n 页请求弹出 n 个不相关的页）
+ *   - buddy：当前的伙伴分配器（2^k 页物理连续块）
+ *   统计分配延迟（cycle）与负载结束时的最大连续空闲块。
+ *
+ * 为保证可比性，两种分配器都只在 BENCH_PAGES 个空闲页上运行：
+ * buddy 测试前先按阶“压舱”占掉多余的空闲内存，结束后再归还。
+ *
+ * bench_map_region:
+ *   在一张独立页表上映射/解除映射 128MB，对比：
+ *   - per-page：旧做法，每页 walk_lookup + map_page（两次完整遍历）
+ *   - range 4K：范围遍历器，pa 故意错开 4KB，强制使用 4KB 叶子
+ *   - range 2M：范围遍历器，va/pa 对齐，使用 2MB 大页
+ *
+ * bench_walk_latency:
+ *   软件页表遍历的延迟（cycle/次），页表层数由构建时的分页模式决定；
+ *   分别用 Sv39 与 Sv48（PAGING=sv48）构建各运行一次即可对比：
+ *   - lookup seq / rand：已映射的 4KB 页上顺序、随机地址的 walk_lookup
+ *   - create：路径上的中间表都已存在时的 walk_create
+ *   - sparse：每次落在不同根表项下的稀疏地址（大范围稀疏保留的情形）
+ *
+ * bench_pt_suite:
+ *   逐次计时的微基准，输出 p50/p90/p99/max（已扣除 rdcycle 自身开销），
+ *   每项都分顺序与随机两种地址模式：
+ *   - walk：walk_lookup、walk_create（中间表已存在）
+ *   - map/unmap：map_page 与单页 unmap_range 的吞吐
+ *   - TLB：在内核页表中用 4KB 或 2MB 叶子映射 64MB，按 4KB 步长访问。
+ *     本内核运行在 M 模式，借助 mstatus.MPRV 让 load 按 S 模式经 satp 翻译；
+ *     4KB 映射远超 TLB 覆盖范围，每次访问都是一次硬件页表遍历
+ *
+ * bench_page_clear:
+ *   页清零带宽（cycle/页、字节/cycle），对比：
+ *   - byte：逐字节写 0（未优化的基线）
+ *   - word：clear_pages 的 64 位字写入路径
+ *   - cbo.zero：clear_pages 的 Zicboz 路径（启动时未探测到则跳过）
+ */
+#include "bench.h"
+#include "kvminit.h"
+#include "pagetable.h"
+#include "pmm.h"
+#include "printf.h"
+#include "riscv.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define BENCH_PAGES     64   /* 参与测试的空闲页数 */
+#define BENCH_SLOTS     16   /* 同时存活的分配数 */
+#define BENCH_OPS       512  /* 每轮操作数 */
+#define BENCH_MAX_ORDER 2    /* 请求大小：1/2/4 页 */
+#define BALLAST_MAX     64   /* 压舱块数量上限 */
+
+/* 简单 LCG：两轮使用同一种子，得到完全相同的操作序列 */
+static uint64_t bench_seed;
+static uint32_t bench_rand(void) {
+    bench_seed = bench_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t)(bench_seed >> 33);
+}
+
+struct bench_result {
+    uint64_t alloc_cycles; /* 成功分配的总 cycle */
+    int allocs;            /* 成功分配次数 */
+    int failures;          /* 分配失败次数 */
+    int free_pages;        /* 负载结束时空闲页数 */
+    int largest_run;       /* 负载结束时最大连续空闲页数 */
+};
+
+/* ---------- 旧栈式分配器模型 ---------- */
+
+static void *stack_pages[BENCH_PAGES];
+static int stack_top;
+
+static void stack_push(void *p) { stack_pages[stack_top++] = p; }
+
+/* 与旧 alloc_page 一致：弹出栈顶并逐字节清零 */
+static void *stack_pop(void) {
+    void *p = stack_pages[--stack_top];
+    for (int i = 0; i < PAGE_SIZE; i++) ((unsigned char*)p)[i] = 0;
+    return p;
+}
+
+/* 空闲页按地址排序后求最长连续段 */
+static int stack_largest_run(void) {
+    uint64_t a[BENCH_PAGES];
+    int n = stack_top;
+    for (int i = 0; i < n; i++) {
+        uint64_t v = (uint64_t)stack_pages[i];
+        int j = i;
+        while (j > 0 && a[j - 1] > v) { a[j] = a[j - 1]; j--; }
+        a[j] = v;
+    }
+    int best = n ? 1 : 0, run = 1;
+    for (int i = 1; i < n; i++) {
+        run = (a[i] == a[i - 1] + PAGE_SIZE) ? run + 1 : 1;
+        if (run > best) best = run;
+    }
+    return best;
+}
+
+static void run_stack(struct bench_result *r) {
+    void *slot[BENCH_SLOTS][1 << BENCH_MAX_ORDER];
+    int slot_n[BENCH_SLOTS] = {0};
+
+    bench_seed = 12345;
+    for (int op = 0; op < BENCH_OPS; op++) {
+        int s = bench_rand() % BENCH_SLOTS;
+        if (slot_n[s]) {
+            for (int i = 0; i < slot_n[s]; i++) stack_push(slot[s][i]);
+            slot_n[s] = 0;
+            continue;
+        }
+        int n = 1 << (bench_rand() % (BENCH_MAX_ORDER + 1));
+        uint64_t t0 = r_cycle();
+        if (stack_top < n) {
+            r->failures++;
+            continue;
+        }
+        for (int i = 0; i < n; i++) slot[s][i] = stack_pop();
+        r->alloc_cycles += r_cycle() - t0;
+        r->allocs++;
+        slot_n[s] = n;
+    }
+
+    r->free_pages = stack_top;
+    r->largest_run = stack_largest_run();
+
+    for (int s = 0; s < BENCH_SLOTS; s++) {
+        for (int i = 0; i < slot_n[s]; i++) stack_push(slot[s][i]);
+    }
+}
+
+/* ---------- buddy 分配器 ---------- */
+
+static void run_buddy(struct bench_result *r) {
+    void *slot[BENCH_SLOTS] = {0};
+    int slot_order[BENCH_SLOTS];
+
+    bench_seed = 12345;
+    for (int op = 0; op < BENCH_OPS; op++) {
+        int s = bench_rand() % BENCH_SLOTS;
+        if (slot[s]) {
+            free_pages_order(slot[s], slot_order[s]);
+            slot[s] = NULL;
+            continue;
+        }
+        int order = bench_rand() % (BENCH_MAX_ORDER + 1);
+        uint64_t t0 = r_cycle();
+        void *p = alloc_pages_order(order);
+        uint64_t t1 = r_cycle();
+        if (!p) {
+            r->failures++;
+            continue;
+        }
+        r->alloc_cycles += t1 - t0;
+        r->allocs++;
+        slot[s] = p;
+        slot_order[s] = order;
+    }
+
+    r->free_pages = (int)pmm_free_pages();
+    int lo = pmm_largest_free_order();
+    r->largest_run = lo < 0 ? 0 : 1 << lo;
+
+    for (int s = 0; s < BENCH_SLOTS; s++) {
+        if (slot[s]) free_pages_order(slot[s], slot_order[s]);
+    }
+}
+
+static void print_result(const char *name, struct bench_result *r) {
+    int avg = r->allocs ? (int)(r->alloc_cycles / r->allocs) : 0;
+    printf("  %s: avg alloc %d cycles, %d allocs, %d failures, "
+           "free %d pages, largest contiguous %d pages\n",
+           name, avg, r->allocs, r->failures, r->free_pages, r->largest_run);
+}
+
+/**
+ * bench_pmm_fragmentation - 栈式分配器与 buddy 分配器的碎片化对比
+ */
+void bench_pmm_fragmentation(void) {
+    struct bench_result st = {0}, bd = {0};
+
+    if (pmm_free_pages() < BENCH_PAGES) {
+        printf("bench: need %d free pages, only %d\n",
+               BENCH_PAGES, (int)pmm_free_pages());
+        return;
+    }
+    printf("bench: pmm fragmentation, %d pages, %d ops, 1..%d pages per request\n",
+           BENCH_PAGES, BENCH_OPS, 1 << BENCH_MAX_ORDER);
+
+    /* 栈式模型：从 buddy 取 BENCH_PAGES 个单页，按地址升序入栈 */
+    stack_top = 0;
+    for (int i = 0; i < BENCH_PAGES; i++) stack_push(alloc_pages_order(0));
+    run_stack(&st);
+    while (stack_top > 0) free_pages_order(stack_pages[--stack_top], 0);
+
+    /* buddy：压舱到只剩 BENCH_PAGES 个空闲页 */
+    void *ballast[BALLAST_MAX];
+    int ballast_order[BALLAST_MAX];
+    int nb = 0;
+    while (pmm_free_pages() > BENCH_PAGES && nb < BALLAST_MAX) {
+        uint64_t extra = pmm_free_pages() - BENCH_PAGES;
+        int order = pmm_largest_free_order();
+        while ((1UL << order) > extra) order--;
+        ballast[nb] = alloc_pages_order(order);
+        ballast_order[nb++] = order;
+    }
+    run_buddy(&bd);
+    while (nb > 0) {
+        nb--;
+        free_pages_order(ballast[nb], ballast_order[nb]);
+    }
+
+    print_result("stack", &st);
+    print_result("buddy", &bd);
+}
+
+/* ---------- 页表范围映射 ---------- */
+
+#define MAP_BENCH_VA   0x100000000UL            /* 4GB：内核页表之外的空闲区域 */
+#define MAP_BENCH_SIZE (128UL * 1024 * 1024)
+
+static void print_map_result(const char *name, uint64_t map_cycles, uint64_t unmap_cycles,
+                             int tables) {
+    printf("  %s: map %d cycles, unmap %d cycles, %d page-table pages\n",
+           name, (int)map_cycles, (int)unmap_cycles, tables);
+}
+
+/* 在新页表上映射 MAP_BENCH_SIZE 后解除，pa_start 决定能否使用大页 */
+static void run_map_range(const char *name, uint64_t pa_start) {
+    pagetable_t pt = create_pagetable();
+    if (!pt) return;
+    struct pt_usage u;
+
+    uint64_t t0 = r_cycle();
+    int r = map_region(pt, MAP_BENCH_VA, pa_start, MAP_BENCH_SIZE, PTE_R | PTE_W);
+    uint64_t t1 = r_cycle();
+    /* 页表页来自缓存池，按 PMM 空闲页数之差统计不准，直接数表（含根页表） */
+    pagetable_usage(pt, &u);
+    uint64_t t2 = r_cycle();
+    unmap_region(pt, MAP_BENCH_VA, MAP_BENCH_SIZE, 0);
+    uint64_t t3 = r_cycle();
+
+    if (r == 0) print_map_result(name, t1 - t0, t3 - t2, u.tables);
+    else printf("  %s: map_region failed\n", name);
+    destroy_pagetable(pt);
+}
+
+/* 旧 map_region 的做法：逐页检查再建立映射，没有 unmap，只能整表销毁 */
+static void run_map_per_page(uint64_t pa_start) {
+    pagetable_t pt = create_pagetable();
+    if (!pt) return;
+    struct pt_usage u;
+
+    uint64_t t0 = r_cycle();
+    for (uint64_t off = 0; off < MAP_BENCH_SIZE; off += PAGE_SIZE) {
+        pte_t *existing = walk_lookup(pt, MAP_BENCH_VA + off);
+        if (existing && (*existing & PTE_V)) continue;
+        if (map_page(pt, MAP_BENCH_VA + off, pa_start + off, PTE_R | PTE_W) != 0) break;
+    }
+    uint64_t t1 = r_cycle();
+    pagetable_usage(pt, &u);
+    uint64_t t2 = r_cycle();
+    destroy_pagetable(pt);
+    uint64_t t3 = r_cycle();
+
+    print_map_result("per-page (unmap = destroy)", t1 - t0, t3 - t2, u.tables);
+}
+
+/**
+ * bench_map_region - 128MB 范围映射/解除映射的开销对比
+ */
+void bench_map_region(void) {
+    extern char _end[];
+    uint64_t pa = ((uint64_t)_end + LEVEL_SIZE(1) - 1) & ~(LEVEL_SIZE(1) - 1);
+
+    printf("bench: map/unmap %d MB at %p\n",
+           (int)(MAP_BENCH_SIZE >> 20), (void*)MAP_BENCH_VA);
+    run_map_per_page(pa + PAGE_SIZE);
+    run_map_range("range 4K", pa + PAGE_SIZE);
+    run_map_range("range 2M", pa);
+}
+
+/* ---------- 页表遍历延迟 ---------- */
+
+#define WALK_BENCH_VA    0x100000000UL   /* 与 MAP_BENCH_VA 相同的空闲区域 */
+#define WALK_BENCH_PAGES 4096            /* 16MB，4KB 叶子 */
+#define WALK_BENCH_OPS   4096
+#define WALK_SPARSE      64              /* 稀疏测试使用的根表项数 */
+/* 根表项 8 起，避开上面的 16MB 区域，且都在低半部（< 256） */
+#define SPARSE_VA(i)     ((uint64_t)(8 + (i)) << VPN_SHIFT(PT_ROOT_LEVEL))
+
+static void print_walk_result(const char *name, uint64_t cycles, int ops) {
+    printf("  %s: %d cycles/walk\n", name, (int)(cycles / ops));
+}
+
+/**
+ * bench_walk_latency - 当前分页模式下 walk_lookup / walk_create 的平均延迟
+ */
+void bench_walk_latency(void) {
+    extern char _end[];
+    uint64_t pa = PAGE_ROUND_UP((uint64_t)_end) + PAGE_SIZE;   /* 错开 2MB 对齐，强制 4KB 叶子 */
+    pagetable_t pt = create_pagetable();
+    if (!pt) return;
+    if (map_region(pt, WALK_BENCH_VA, pa, WALK_BENCH_PAGES * PAGE_SIZE, PTE_R | PTE_W) != 0) {
+        destroy_pagetable(pt);
+        return;
+    }
+    /* 稀疏：每个根表项下各映射一页，根表之外的每一层都各不相同 */
+    int sparse = 0;
+    for (int i = 0; i < WALK_SPARSE; i++) {
+        if (map_page(pt, SPARSE_VA(i), pa, PTE_R) != 0) break;
+        sparse++;
+    }
+    printf("bench: page walk latency, %s (%d levels), %d pages\n",
+           PT_MODE_NAME, PT_LEVELS, WALK_BENCH_PAGES);
+
+    volatile uint64_t sink = 0;
+    uint64_t t0 = r_cycle();
+    for (int i = 0; i < WALK_BENCH_OPS; i++) {
+        sink += *walk_lookup(pt, WALK_BENCH_VA + (uint64_t)(i % WALK_BENCH_PAGES) * PAGE_SIZE);
+    }
+    print_walk_result("lookup seq", r_cycle() - t0, WALK_BENCH_OPS);
+
+    bench_seed = 777;
+    t0 = r_cycle();
+    for (int i = 0; i < WALK_BENCH_OPS; i++) {
+        uint64_t page = bench_rand() % WALK_BENCH_PAGES;
+        sink += *walk_lookup(pt, WALK_BENCH_VA + page * PAGE_SIZE);
+    }
+    print_walk_result("lookup rand", r_cycle() - t0, WALK_BENCH_OPS);
+
+    t0 = r_cycle();
+    for (int i = 0; i < WALK_BENCH_OPS; i++) {
+        sink += *walk_create(pt, WALK_BENCH_VA + (uint64_t)(i % WALK_BENCH_PAGES) * PAGE_SIZE);
+    }
+    print_walk_result("create (tables present)", r_cycle() - t0, WALK_BENCH_OPS);
+
+    if (sparse > 0) {
+        t0 = r_cycle();
+        for (int i = 0; i < WALK_BENCH_OPS; i++) {
+            sink += *walk_lookup(pt, SPARSE_VA(i % sparse));
+        }
+        print_walk_result("lookup sparse", r_cycle() - t0, WALK_BENCH_OPS);
+    }
+    (void)sink;
+    destroy_pagetable(pt);
+}
+
+/* ---------- 页表遍历 / TLB 微基准 ---------- */
+
+#define SUITE_VA      0x100000000UL
+#define SUITE_SAMPLES 1024
+#define SUITE_SPREAD  (16 * PAGE_SIZE)   /* map/unmap 测试相邻样本的间距 */
+#define TLB_REGION    (64UL << 20)       /* 4KB 叶子 16384 个，2MB 叶子 32 个 */
+
+static uint32_t samples[SUITE_SAMPLES];
+static uint16_t order[SUITE_SAMPLES];    /* 随机模式下的访问顺序（排列） */
+static uint64_t cycle_overhead;
+
+/* 两次相邻 rdcycle 的最小差值，从每个样本中扣除 */
+static void measure_overhead(void) {
+    cycle_overhead = ~0UL;
+    for (int i = 0; i < 64; i++) {
+        uint64_t t0 = r_cycle();
+        uint64_t t1 = r_cycle();
+        if (t1 - t0 < cycle_overhead) cycle_overhead = t1 - t0;
+    }
+}
+
+static inline uint32_t sample_cycles(uint64_t t0, uint64_t t1) {
+    uint64_t d = t1 - t0;
+    d = d > cycle_overhead ? d - cycle_overhead : 0;
+    return d > 0xFFFFFFFFUL ? 0xFFFFFFFFU : (uint32_t)d;
+}
+
+/* 顺序模式为 0..n-1，随机模式为同一组下标的随机排列 */
+static void make_order(int n, int random) {
+    for (int i = 0; i < n; i++) order[i] = (uint16_t)i;
+    if (!random) return;
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(bench_rand() % (uint32_t)(i + 1));
+        uint16_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static void sort_samples(uint32_t *a, int n) {
+    for (int gap = n / 2; gap > 0; gap /= 2) {
+        for (int i = gap; i < n; i++) {
+            uint32_t v = a[i];
+            int j = i;
+            while (j >= gap && a[j - gap] > v) { a[j] = a[j - gap]; j -= gap; }
+            a[j] = v;
+        }
+    }
+}
+
+static void print_percentiles(const char *name, const char *pattern, int n) {
+    uint64_t total = 0;
+    for (int i = 0; i < n; i++) total += samples[i];
+    sort_samples(samples, n);
+    printf("  %s %s: avg %d  p50 %d  p90 %d  p99 %d  max %d cycles\n", name, pattern,
+           (int)(total / n), (int)samples[n / 2], (int)samples[n * 9 / 10],
+           (int)samples[n * 99 / 100], (int)samples[n - 1]);
+}
+
+static const char *pattern_name(int random) { return random ? "rand" : "seq "; }
+
+/* walk：SUITE_SAMPLES 个 4KB 页已映射的私有页表上逐次计时 */
+static void suite_walks(uint64_t pa) {
+    pagetable_t pt = create_pagetable();
+    if (!pt) return;
+    if (map_region(pt, SUITE_VA, pa, SUITE_SAMPLES * PAGE_SIZE, PTE_R | PTE_W) == 0) {
+        volatile uint64_t sink = 0;
+        for (int random = 0; random <= 1; random++) {
+            make_order(SUITE_SAMPLES, random);
+            for (int i = 0; i < SUITE_SAMPLES; i++) {
+                uint64_t va = SUITE_VA + (uint64_t)order[i] * PAGE_SIZE;
+                uint64_t t0 = r_cycle();
+                pte_t *pte = walk_lookup(pt, va);
+                uint64_t t1 = r_cycle();
+                sink += *pte;
+                samples[i] = sample_cycles(t0, t1);
+            }
+            print_percentiles("walk_lookup", pattern_name(random), SUITE_SAMPLES);
+        }
+        for (int random = 0; random <= 1; random++) {
+            make_order(SUITE_SAMPLES, random);
+            for (int i = 0; i < SUITE_SAMPLES; i++) {
+                uint64_t va = SUITE_VA + (uint64_t)order[i] * PAGE_SIZE;
+                uint64_t t0 = r_cycle();
+                pte_t *pte = walk_create(pt, va);
+                uint64_t t1 = r_cycle();
+                sink += *pte;
+                samples[i] = sample_cycles(t0, t1);
+            }
+            print_percentiles("walk_create", pattern_name(random), SUITE_SAMPLES);
+        }
+        (void)sink;
+    }
+    destroy_pagetable(pt);
+}
+
+/* map/unmap：新页表上逐页建立映射，再逐页解除（含单页 TLB 刷新） */
+static void suite_map_unmap(uint64_t pa) {
+    for (int random = 0; random <= 1; random++) {
+        pagetable_t pt = create_pagetable();
+        if (!pt) return;
+        make_order(SUITE_SAMPLES, random);
+        uint64_t total = 0;
+        for (int i = 0; i < SUITE_SAMPLES; i++) {
+            uint64_t va = SUITE_VA + (uint64_t)order[i] * SUITE_SPREAD;
+            uint64_t t0 = r_cycle();
+            int r = map_page(pt, va, pa, PTE_R | PTE_W);
+            uint64_t t1 = r_cycle();
+            if (r != 0) break;
+            samples[i] = sample_cycles(t0, t1);
+            total += samples[i];
+        }
+        print_percentiles("map_page   ", pattern_name(random), SUITE_SAMPLES);
+        printf("    %d pages/Mcycle\n", (int)(SUITE_SAMPLES * 1000000UL / (total ? total : 1)));
+
+        total = 0;
+        for (int i = 0; i < SUITE_SAMPLES; i++) {
+            uint64_t va = SUITE_VA + (uint64_t)order[i] * SUITE_SPREAD;
+            uint64_t t0 = r_cycle();
+            unmap_range(pt, va, PAGE_SIZE, 0);
+            uint64_t t1 = r_cycle();
+            samples[i] = sample_cycles(t0, t1);
+            total += samples[i];
+        }
+        print_percentiles("unmap      ", pattern_name(random), SUITE_SAMPLES);
+        printf("    %d pages/Mcycle\n", (int)(SUITE_SAMPLES * 1000000UL / (total ? total : 1)));
+        destroy_pagetable(pt);
+    }
+}
+
+/*
+ * TLB：在内核页表里映射 TLB_REGION，打开 MPRV 后逐次计时单个 load。
+ * MPRV 期间栈、全局变量的访问也经过翻译，内核页表对它们是恒等映射
+ */
+static void suite_tlb(uint64_t pa_2m) {
+    /* S 模式访问至少要命中一项 PMP：第 0 项 TOR 覆盖全部地址，RWX */
+    w_pmpaddr0(~0UL >> 10);
+    w_pmpcfg0(0x0F);
+
+    for (int huge = 0; huge <= 1; huge++) {
+        /* pa 错开 4KB 时只能使用 4KB 叶子 */
+        uint64_t pa = huge ? pa_2m : pa_2m + PAGE_SIZE;
+        if (map_region(kernel_pagetable, SUITE_VA, pa, TLB_REGION, PTE_R) != 0) return;
+        const int pages = (int)(TLB_REGION / PAGE_SIZE);
+        for (int random = 0; random <= 1; random++) {
+            volatile uint64_t sink = 0;
+            sfence_vma_all();
+            uint64_t old = r_mstatus();
+            w_mstatus((old & ~MSTATUS_MPP_MASK) | MSTATUS_MPP_S | MSTATUS_MPRV);
+            for (int i = 0; i < SUITE_SAMPLES; i++) {
+                /* 顺序：4KB 步长，每次跨一页；随机：在整个区域内随机选页 */
+                uint64_t page = random ? bench_rand() % (uint32_t)pages
+                                       : (uint64_t)(i * (pages / SUITE_SAMPLES));
+                volatile uint64_t *p = (volatile uint64_t *)(SUITE_VA + page * PAGE_SIZE);
+                uint64_t t0 = r_cycle();
+                sink += *p;
+                uint64_t t1 = r_cycle();
+                samples[i] = sample_cycles(t0, t1);
+            }
+            w_mstatus(old);
+            (void)sink;
+            print_percentiles(huge ? "tlb 2M leaves" : "tlb 4K leaves", pattern_name(random),
+                              SUITE_SAMPLES);
+        }
+        unmap_region(kernel_pagetable, SUITE_VA, TLB_REGION, 0);
+    }
+}
+
+/**
+ * bench_pt_suite - 页表遍历、map/unmap 与 TLB 缺失的逐次计时微基准
+ *
+ * 需要在 kvminithart 之后运行（TLB 部分使用内核页表）
+ */
+void bench_pt_suite(void) {
+    extern char _end[];
+    uint64_t pa = (PAGE_ROUND_UP((uint64_t)_end) + LEVEL_SIZE(1) - 1) & ~(LEVEL_SIZE(1) - 1);
+
+    measure_overhead();
+    bench_seed = 2024;
+    printf("bench: page-table suite, %s, %d samples per row, rdcycle overhead %d cycles\n",
+           PT_MODE_NAME, SUITE_SAMPLES, (int)cycle_overhead);
+    suite_walks(pa);
+    suite_map_unmap(pa);
+    suite_tlb(pa);
+}
+
+/* ---------------------------------------------------------------------- */
+
+#define CLEAR_PAGES 64     /* 256KB，超过 L1 容量 */
+#define CLEAR_ROUNDS 8
+
+static void print_clear_result(const char *name, uint64_t cycles) {
+    uint64_t pages = (uint64_t)CLEAR_PAGES * CLEAR_ROUNDS;
+    uint64_t per_page = cycles / pages;
+    /* 字节/cycle 保留两位小数 */
+    uint64_t bpc100 = cycles ? pages * PAGE_SIZE * 100 / cycles : 0;
+    printf("  %s: %d cycles/page, %d.%d%d bytes/cycle\n", name, (int)per_page,
+           (int)(bpc100 / 100), (int)(bpc100 / 10 % 10), (int)(bpc100 % 10));
+}
+
+static uint64_t time_byte_clear(uint8_t *buf) {
+    uint64_t t0 = r_cycle();
+    for (int r = 0; r < CLEAR_ROUNDS; r++) {
+        volatile uint8_t *b = buf;
+        for (uint64_t i = 0; i < CLEAR_PAGES * PAGE_SIZE; i++) b[i] = 0;
+    }
+    return r_cycle() - t0;
+}
+
+static uint64_t time_clear_pages(uint8_t *buf) {
+    uint64_t t0 = r_cycle();
+    for (int r = 0; r < CLEAR_ROUNDS; r++) clear_pages(buf, CLEAR_PAGES);
+    return r_cycle() - t0;
+}
+
+/**
+ * bench_page_clear - 页清零带宽：字节循环 / 字写入 / cbo.zero
+ *
+ * 临时切换 pmm_set_cbo_block 以测量两条 clear_pages 路径，结束后恢复
+ */
+void bench_page_clear(void) {
+    int order = 6;   /* 2^6 = CLEAR_PAGES */
+    uint8_t *buf = (uint8_t*)alloc_pages_flags(order, 0);
+    if (!buf) {
+        printf("bench: cannot allocate %d pages\n", CLEAR_PAGES);
+        return;
+    }
+    int block = pmm_cbo_block();
+    printf("bench: clearing %d pages x %d rounds\n", CLEAR_PAGES, CLEAR_ROUNDS);
+
+    print_clear_result("byte    ", time_byte_clear(buf));
+
+    pmm_set_cbo_block(0);
+    print_clear_result("word    ", time_clear_pages(buf));
+    pmm_set_cbo_block(block);
+
+    if (block) {
+        print_clear_result("cbo.zero", time_clear_pages(buf));
+    } else {
+        printf("  cbo.zero: Zicboz not available\n");
+    }
+
+    /* 校验：清零后整块应为 0 */
+    buf[123] = 0x5A;
+    clear_pages(buf, CLEAR_PAGES);
+    for (uint64_t i = 0; i < CLEAR_PAGES * PAGE_SIZE; i++) {
+        if (buf[i]) {
+            printf("bench: clear_pages left non-zero byte at offset %d\n", (int)i);
+            break;
+        }
+    }
+    free_pages_order(buf, order);
+}
@@ -0,0 +1,11 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* In-kernel benchmarks (results are printed to the console) */
+void bench_pmm_fragmentation(void);
+void bench_map_region(void);
+void bench_walk_latency(void);
+void bench_pt_suite(void);
+void bench_page_clear(void);
+
+#endif /* BENCH_H */
@@ -8,11 +8,14 @@
  * 核心概念：
  * - 恒等映射：VA = PA，简化页表设置
  * - 权限控制：文本段(RX)，数据段(RW)，设备(RW)
+ * - 全局映射：内核映射都带 PTE_G，在所有地址空间中相同，
+ *   TLB 项不随 ASID 切换失效，按 ASID 刷新时也不会被清掉
  * - SATP寄存器：控制MMU模式和页表基址
  */
 #include "kvminit.h"
 #include "pmm.h"
 #include "printf.h"
+#include "riscv.h"
 #include <stdint.h>
 
 /* QEMU virt 机器常量 */
@@ -25,31 +28,15 @@
 #ifndef UART0
 #define UART0 0x10000000UL  /* UART设备地址 */
 #endif
+#ifndef CLINT
+#define CLINT 0x02000000UL  /* CLINT（mtimecmp/mtime）地址 */
+#define CLINT_SIZE 0x10000UL
+#endif
 
 /* 全局内核页表指针 */
 pagetable_t kernel_pagetable = 0;
 
-/**
- * w_satp - 写SATP寄存器（启用/禁用MMU）
- * 
- * SATP寄存器格式：
- * - [63:60]: MODE（8 = Sv39）
- * - [59:44]: ASID（地址空间ID）
- * - [43:0]: PPN（页表物理页号）
- */
-static inline void w_satp(uint64_t satp) {
-    asm volatile("csrw satp, %0" :: "r"(satp));
-}
-
-/**
- * sfence_vma - 刷新TLB（Translation Lookaside Buffer）
- * 
- * 作用：清除页表缓存，使新的页表设置立即生效
- * 必须在设置SATP后调用
- */
-static inline void sfence_vma(void) {
-    asm volatile("sfence.vma" ::: "memory");
-}
+/* w_satp / sfence_vma_all 见 riscv.h */
 
 /**
  * map_region - 映射连续的物理内存区域
@@ -59,7 +46,9 @@ static inline void sfence_vma(void) {
  * 特性：
  * - 自动页对齐：向下对齐起始地址，向上对齐结束地址
  * - 已映射跳过：如果页面已映射，跳过而不是失败
- * - 逐页映射：以4KB为单位建立映射
+ * - 大页优先：va、pa 与剩余长度都按 1GB/2MB 对齐且槽位空闲时，
+ *   直接放一个巨页/大页叶子；区域两端不满足对齐的部分退回 4KB 页
+ * - 单次遍历：由 map_range 实现，每个页表页只进入一次
  */
 int map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm) {
     if (!pt) return -1;
@@ -69,24 +58,50 @@ int map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm
     uint64_t pa_start = PAGE_ROUND_DOWN(pa);
     uint64_t va_end   = PAGE_ROUND_UP(va + size);
 
-    /* 逐页建立映射 */
-    for (uint64_t a = va_start, p = pa_start; a < va_end; a += PAGE_SIZE, p += PAGE_SIZE) {
-        /* 检查是否已映射，避免重复映射 */
-        pte_t *existing = walk_lookup(pt, a);
-        if (existing && (*existing & PTE_V)) {
-            /* 已存在映射，跳过 */
-            continue;
-        }
-        /* 建立新映射 */
-        if (map_page(pt, a, p, perm) != 0) {
-            printf("map_region: map_page failed va=%p pa=%p\n", (void*)a, (void*)p);
-            return -1;
-        }
+    if (map_range(pt, va_start, pa_start, va_end - va_start, perm) != 0) {
+        printf("map_region: failed va=%p pa=%p size=%p\n",
+               (void*)va_start, (void*)pa_start, (void*)(va_end - va_start));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * unmap_region - 解除连续区域的映射
+ * 
+ * 参数：do_free - 非 0 时同时释放叶子指向的物理页
+ * 
+ * 部分覆盖的大页会被拆分，清空的页表页被回收；
+ * TLB 在整个范围处理完后统一刷新一次
+ */
+int unmap_region(pagetable_t pt, uint64_t va, uint64_t size, int do_free) {
+    if (!pt) return -1;
+
+    uint64_t va_start = PAGE_ROUND_DOWN(va);
+    uint64_t va_end   = PAGE_ROUND_UP(va + size);
+
+    if (unmap_range(pt, va_start, va_end - va_start, do_free) != 0) {
+        printf("unmap_region: failed va=%p size=%p\n",
+               (void*)va_start, (void*)(va_end - va_start));
+        return -1;
     }
     return 0;
 }
 
 
+/*
+ * map_mmio - 映射设备窗口
+ *
+ * 设备寄存器只占几页，但单独映射需要一整张 4KB 叶子页表；
+ * 把窗口向外扩到 2MB 边界后只需一个大页叶子。扩出的部分仍是设备地址空间，不含 DRAM
+ */
+static void map_mmio(pagetable_t pt, uint64_t base, uint64_t size) {
+    uint64_t mask = LEVEL_SIZE(1) - 1;
+    uint64_t start = base & ~mask;
+    uint64_t end = (base + size + mask) & ~mask;
+    map_region(pt, start, start, end - start, PTE_R | PTE_W | PTE_G);
+}
+
 /**
  * kvminit - 创建并初始化内核页表
  * 
@@ -96,8 +111,12 @@ int map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm
  * 1. 内核代码段：_text到_etext（R|X：可读可执行）
  * 2. 只读数据段：_rodata到_erodata（R：只读）
  * 3. 数据+BSS段：_data到_end（R|W：可读可写）
- * 4. 额外物理内存：内核结束后10页（R|W：可读可写）
- * 5. 设备：UART（R|W：可读可写）
+ * 4. 直接映射全部 DRAM：KERNBASE 到 KERNBASE+MEMSIZE（R|W），
+ *    已映射的内核段保持原权限，其余部分按 2MB/1GB 叶子映射
+ * 5. 设备：UART、CLINT 所在的 2MB 窗口（R|W：可读可写；S 模式通过 CLINT 重装时钟）
+ * 
+ * 内核段先以 4KB/2MB 粒度映射以保持精确权限，之后的直接映射用尽量大的叶子，
+ * 页表页数与 TLB 项都降到最少。结束时输出页表页数、各级叶子数与耗时。
  * 
  * 为什么使用恒等映射？
  * - 简化页表设置
@@ -105,6 +124,8 @@ int map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm
  * - 内核代码期望直接物理地址访问
  */
 void kvminit(void) {
+    uint64_t t0 = r_cycle();
+
     /* 创建根页表 */
     kernel_pagetable = create_pagetable();
     if (!kernel_pagetable) {
@@ -114,33 +135,39 @@ void kvminit(void) {
 
     /* 获取链接器定义的内核布局符号 */
     extern char _text[], _etext[], _rodata[], _erodata[];
-    extern char _data[], _edata[], _end[];
+    extern char _data[], _end[];
 
     uint64_t text = (uint64_t)_text;
     uint64_t etext = (uint64_t)_etext;
     uint64_t rodata = (uint64_t)_rodata;
     uint64_t erodata = (uint64_t)_erodata;
     uint64_t data = (uint64_t)_data;
-    uint64_t edata = (uint64_t)_edata;
     uint64_t end = (uint64_t)_end;
 
     /* 1. 映射内核代码段（可读可执行，不能写）*/
-    map_region(kernel_pagetable, text, text, (uint64_t)(etext - text), PTE_R | PTE_X);
+    map_region(kernel_pagetable, text, text, (uint64_t)(etext - text), PTE_R | PTE_X | PTE_G);
 
     /* 2. 映射只读数据段（只读）*/
     if (erodata > rodata)
-        map_region(kernel_pagetable, rodata, rodata, (uint64_t)(erodata - rodata), PTE_R);
+        map_region(kernel_pagetable, rodata, rodata, (uint64_t)(erodata - rodata),
+                   PTE_R | PTE_G);
 
     /* 3. 映射数据+BSS段（可读可写）*/
-    map_region(kernel_pagetable, data, data, (uint64_t)(end - data), PTE_R | PTE_W);
+    map_region(kernel_pagetable, data, data, (uint64_t)(end - data), PTE_R | PTE_W | PTE_G);
 
-    /* 4. 映射额外的物理内存（为内核预留）*/
-    map_region(kernel_pagetable, end, end, PAGE_SIZE * 10, PTE_R | PTE_W);
+    /* 4. 直接映射全部 DRAM（PMM 管理的全部页，含页表页自身；内核段已映射，跳过）*/
+    map_region(kernel_pagetable, KERNBASE, KERNBASE, MEMSIZE, PTE_R | PTE_W | PTE_G);
 
-    /* 5. 映射设备区域（UART等）*/
-    map_region(kernel_pagetable, UART0, UART0, PAGE_SIZE, PTE_R | PTE_W);
+    /* 5. 映射设备区域（UART、CLINT）：窗口扩到 2MB 边界，各用一个大页叶子 */
+    map_mmio(kernel_pagetable, UART0, PAGE_SIZE);
+    map_mmio(kernel_pagetable, CLINT, CLINT_SIZE);
 
-    printf("kvminit: kernel_pagetable created and regions mapped\n");
+    uint64_t t1 = r_cycle();
+    struct pt_usage u;
+    pagetable_usage(kernel_pagetable, &u);
+    printf("kvminit: kernel_pagetable created, %d page-table pages, "
+           "leaves 4K=%d 2M=%d 1G=%d, %d cycles\n",
+           u.tables, u.leaves[0], u.leaves[1], u.leaves[2], (int)(t1 - t0));
 }
 
 /**
@@ -155,8 +182,8 @@ void kvminit(void) {
  * 4. 刷新TLB（使新设置生效）
  * 
  * SATP寄存器详细格式：
- * - MODE[63:60]=8：Sv39分页模式
- * - ASID[59:44]=0：地址空间ID（单内核，不需要）
+ * - MODE[63:60]=8：Sv39分页模式（以 -DPT_SV48 构建时为 9：Sv48）
+ * - ASID[59:44]=0：内核页表固定使用 ASID 0，进程地址空间由 ASID 分配器分配
  * - PPN[43:0]：页表基址的物理页号
  * 
  * 注意事项：
@@ -170,14 +197,14 @@ void kvminithart(void) {
         return;
     }
     
-    /* 构建SATP值：MODE=8 (Sv39) + 页表物理页号 */
+    /* 构建SATP值：MODE（Sv39/Sv48）+ 页表物理页号 */
     uint64_t satp = MAKE_SATP(kernel_pagetable);
     
     /* 写SATP寄存器：启用MMU */
     w_satp(satp);
     
     /* 刷新TLB：使新的页表设置生效 */
-    sfence_vma();
+    sfence_vma_all();
     
-    printf("kvminithart: satp set %p\n", (void*)satp);
+    printf("kvminithart: satp set %p (%s)\n", (void*)satp, PT_MODE_NAME);
 }
@@ -7,6 +7,8 @@
 #define KERNBASE 0x80000000UL
 #define MEMSIZE (128UL * 1024 * 1024)  // 128MB
 #define UART0 0x10000000UL
+#define CLINT 0x02000000UL
+#define CLINT_SIZE 0x10000UL
 
 /* Global kernel pagetable */
 extern pagetable_t kernel_pagetable;
@@ -15,6 +17,7 @@ extern pagetable_t kernel_pagetable;
 void kvminit(void);
 void kvminithart(void);
 int map_region(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm);
+int unmap_region(pagetable_t pt, uint64_t va, uint64_t size, int do_free);
 
 #endif /* KVMINIT_H */
 
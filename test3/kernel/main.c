@@ -3,12 +3,16 @@
 #include "printf.h"
 #include "pagetable.h"
 #include "kvminit.h"
+#include "bench.h"
+#include "slab.h"
+#include "riscv.h"
 #include <stdint.h>
 #include <stddef.h>
 #define PHYS_MEM_START 0x80000000UL
 #define PHYS_MEM_END   (PHYS_MEM_START + 128 * 1024 * 1024)
 void test_physical_memory(void) {
     printf("=== Physical Memory Test Start ===\n");
+    pmm_log_enable(1);
 
     void *page1 = alloc_page();
     void *page2 = alloc_page();
@@ -42,9 +46,66 @@ void test_physical_memory(void) {
     free_page(page2);
     free_page(page3);
 
+    /* 多页分配：必须物理连续且按块大小对齐 */
+    void *block = alloc_pages(4);
+    if (block && ((uint64_t)block & (4 * 4096 - 1)) == 0) {
+        printf("alloc_pages(4)=%p contiguous & aligned OK\n", block);
+    } else {
+        printf("alloc_pages(4) ERROR: %p\n", block);
+    }
+    free_pages(block, 4);
+    pmm_log_enable(0);
+    pmm_log_dump();
+    pmm_dump();
+
     printf("=== Physical Memory Test End ===\n");
 }
 
+/* slab 测试对象：构造函数写入魔数，用于验证对象复用时保持已构造状态 */
+struct test_obj {
+    int id;
+    int magic;
+    char payload[40];
+};
+#define TEST_OBJ_MAGIC 0x51AB
+
+static void test_obj_ctor(void *obj) {
+    ((struct test_obj*)obj)->magic = TEST_OBJ_MAGIC;
+}
+
+void test_slab(void) {
+    printf("=== Slab Allocator Test Start ===\n");
+
+    struct kmem_cache *c = kmem_cache_create("test_obj", sizeof(struct test_obj), 0,
+                                             test_obj_ctor);
+    if (!c) { printf("kmem_cache_create failed\n"); return; }
+
+    struct test_obj *objs[100];
+    int ok = 1;
+    for (int i = 0; i < 100; i++) {
+        objs[i] = kmem_cache_alloc(c);
+        if (!objs[i] || ((uint64_t)objs[i] & (CACHE_LINE_SIZE - 1)) ||
+            objs[i]->magic != TEST_OBJ_MAGIC) {
+            ok = 0;
+            break;
+        }
+        objs[i]->id = i;
+    }
+    printf("alloc 100 objects: %s\n", ok ? "OK (cache-line aligned, constructed)" : "ERROR");
+    kmem_cache_dump();
+
+    for (int i = 0; i < 100 && objs[i]; i++) {
+        kmem_cache_free(c, objs[i]);
+    }
+    struct test_obj *again = kmem_cache_alloc(c);
+    printf("reuse keeps constructed state: %s\n",
+           (again && again->magic == TEST_OBJ_MAGIC) ? "OK" : "ERROR");
+    kmem_cache_free(c, again);
+    kmem_cache_dump();
+
+    printf("=== Slab Allocator Test End ===\n");
+}
+
 void test_pagetable(void) {
     pagetable_t pt = create_pagetable();
     if (!pt) { printf("create_pagetable failed\n"); return; }
@@ -125,6 +186,15 @@ void test_virtual_memory(void) {
         uint64_t mapped_pa = ((*pte) >> PPN_SHIFT) << 12;
         printf("KERNBASE lookup OK: va=%p -> pa=%p\n", (void*)KERNBASE, (void*)mapped_pa);
     }
+
+    /* 内核镜像之后的大块 DRAM 应当由 2MB 大页映射 */
+    int level;
+    uint64_t mid = KERNBASE + MEMSIZE / 2;
+    pte = walk_lookup_level(kernel_pagetable, mid, &level);
+    if (pte && (*pte & PTE_V)) {
+        printf("Superpage check: va=%p mapped by a level-%d leaf (%d KB)\n",
+               (void*)mid, level, (int)(LEVEL_SIZE(level) / 1024));
+    }
     
     printf("=== Virtual Memory Test End ===\n");
 }
@@ -140,8 +210,15 @@ void main(void) {
     
     /* 测试1: 物理内存管理 */
     printf("\n[Test 1] Physical Memory Manager\n");
-    pmm_init(0, 0);
+    extern char _end[];
+    /* 探测 Zicboz，决定页清零方式 */
+    static uint8_t cbo_probe_buf[CBO_PROBE_MAX] __attribute__((aligned(CBO_PROBE_MAX)));
+    pmm_set_cbo_block(zicboz_probe(cbo_probe_buf));
+    pmm_init((uint64_t)_end, PHYS_MEM_END);
+    /* 相当于空闲循环先运行一次：预先准备一批清零页 */
+    pmm_zero_refill(32);
     test_physical_memory();
+    test_slab();
     
     /* 测试2: 页表管理 */
     printf("\n[Test 2] Page Table Management\n");
@@ -150,10 +227,29 @@ void main(void) {
     /* 测试3: 虚拟内存激活 */
     printf("\n[Test 3] Virtual Memory Activation\n");
     test_virtual_memory();
+
+    /* 测试4: 分配器碎片化基准 */
+    printf("\n[Test 4] PMM Fragmentation Benchmark\n");
+    bench_pmm_fragmentation();
+
+    printf("\n[Test 5] Page Table Range Mapping Benchmark\n");
+    bench_map_region();
+    pt_pool_dump();
+
+    printf("\n[Test 6] Page Walk Latency Benchmark\n");
+    bench_walk_latency();
+
+    printf("\n[Test 7] Page Walk / TLB Microbenchmark Suite\n");
+    bench_pt_suite();
+
+    printf("\n[Test 8] Page Clear Bandwidth Benchmark\n");
+    bench_page_clear();
     
     printf("\n=== All Tests Completed ===\n");
     
+    /* 空闲循环：补充预清零页后等待中断 */
     while (1) {
+        pmm_zero_refill(8);
         asm volatile("wfi");
     }
 }
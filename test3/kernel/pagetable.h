@@ -25,18 +25,66 @@ typedef uint64_t* pagetable_t;
 #define PTE_G (1ULL << 5)
 #define PTE_A (1ULL << 6)
 #define PTE_D (1ULL << 7)
+#define PTE_COW (1ULL << 8)  /* RSW bit: copy-on-write page, W cleared until first store */
 
-/* Va -> VPN extraction for Sv39 (levels 2,1,0) */
+/* PTE <-> physical address */
+#define PTE2PA(pte) (((pte) >> PPN_SHIFT) << 12)
+#define PA2PTE(pa) ((((uint64_t)(pa)) >> 12) << PPN_SHIFT)
+#define PTE_FLAGS(pte) ((pte) & 0x3FFUL)
+
+/* Paging mode is fixed at build time: Sv39 (3 levels, 39-bit VA) by default,
+   Sv48 (4 levels, 48-bit VA) with -DPT_SV48. Walks are unrolled for the
+   chosen depth, so an Sv39 build pays nothing for the option. */
+#ifdef PT_SV48
+#define PT_LEVELS 4
+#define PT_MODE_NAME "Sv48"
+#else
+#define PT_LEVELS 3
+#define PT_MODE_NAME "Sv39"
+#endif
+#define PT_ROOT_LEVEL (PT_LEVELS - 1)
+#define VA_BITS (12 + 9 * PT_LEVELS)
+
+/* Va -> VPN extraction (levels PT_ROOT_LEVEL..0) */
 #define VPN_SHIFT(level) (12 + 9 * (level))
 #define VPN_MASK(va, level) (((va) >> VPN_SHIFT(level)) & 0x1FFUL)
 
+/* Bytes covered by one leaf at each level: 4 KiB, 2 MiB (megapage), 1 GiB (gigapage),
+   512 GiB (terapage, Sv48 only) */
+#define LEVEL_SIZE(level) (1UL << VPN_SHIFT(level))
+
 /* Helper macros for address manipulation */
 #define PAGE_ROUND_DOWN(addr) ((addr) & ~(PAGE_SIZE - 1))
 #define PAGE_ROUND_UP(addr) (((addr) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
 
-/* SATP register encoding for Sv39 */
+/* SATP register encoding */
 #define SATP_MODE_SV39 (8UL << 60)
-#define MAKE_SATP(pt) (SATP_MODE_SV39 | (((uint64_t)(pt)) >> 12))
+#define SATP_MODE_SV48 (9UL << 60)
+#ifdef PT_SV48
+#define SATP_MODE SATP_MODE_SV48
+#else
+#define SATP_MODE SATP_MODE_SV39
+#endif
+#define SATP_ASID_SHIFT 44
+#define SATP_ASID_MASK 0xFFFFUL
+#define SATP_PPN_MASK ((1UL << SATP_ASID_SHIFT) - 1)
+#define MAKE_SATP(pt) (SATP_MODE | (((uint64_t)(pt)) >> 12))
+#define MAKE_SATP_ASID(pt, asid) \
+    (MAKE_SATP(pt) | (((uint64_t)(asid) & SATP_ASID_MASK) << SATP_ASID_SHIFT))
+#define SATP_ASID(satp) (((satp) >> SATP_ASID_SHIFT) & SATP_ASID_MASK)
+
+/* Page-table page pool: pre-zeroed pages reserved for page tables.
+   Pages handed back must have every PTE cleared. */
+struct pt_batch {
+    void *head;
+    void *tail;
+    int n;
+};
+void* alloc_pagetable_page(void);
+void free_pagetable_page(void *page);
+void pt_batch_add(struct pt_batch *b, void *page);
+void free_pagetable_batch(struct pt_batch *b);
+void pt_pool_dump(void);
 
 /* Interface */
 pagetable_t create_pagetable(void);
@@ -44,8 +92,32 @@ void destroy_pagetable(pagetable_t pt);
 
 pte_t* walk_create(pagetable_t pt, uint64_t va); /* alloc intermediate pages if needed */
 pte_t* walk_lookup(pagetable_t pt, uint64_t va); /* no alloc */
+pte_t* walk_create_level(pagetable_t pt, uint64_t va, int level); /* PTE slot at `level` */
+pte_t* walk_lookup_level(pagetable_t pt, uint64_t va, int *level); /* where the walk stops */
 
 int map_page(pagetable_t pt, uint64_t va, uint64_t pa, int perm);
+int map_page_level(pagetable_t pt, uint64_t va, uint64_t pa, int perm, int level);
+
+/* Range walker: one descent per page-table page, TLB flushed once per range */
+int map_range(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm);
+int unmap_range(pagetable_t pt, uint64_t va, uint64_t size, int free_leaves);
+/* Same, but emptied table pages and freed leaf blocks are collected in
+   `defer`; the caller frees them with pt_deferred_free once nothing can
+   reach them (e.g. after other harts have flushed their TLBs) */
+struct pt_deferred {
+    struct pt_batch tables;
+    void *leaves;
+};
+int unmap_range_deferred(pagetable_t pt, uint64_t va, uint64_t size, int free_leaves,
+                         struct pt_deferred *defer);
+void pt_deferred_free(struct pt_deferred *d);
 void dump_pagetable(pagetable_t pt);
 
+/* Page-table footprint: table pages and leaves per level */
+struct pt_usage {
+    int tables;
+    int leaves[PT_LEVELS];
+};
+void pagetable_usage(pagetable_t pt, struct pt_usage *u);
+
 #endif /* PAGETABLE_H */
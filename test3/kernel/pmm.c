@@ -1,139 +1,730 @@
 /**
  * kernel/pmm.c - 物理内存管理器 (Physical Memory Manager)
- * 
+ *
  * 实现原理：
- * 1. 使用静态内存池（64页 = 256KB）
- * 2. 栈式分配：空闲页面存储在数组中，通过索引管理
- * 3. 页对齐：所有分配返回的地址都是4KB对齐的
- * 
+ * 1. 管理 [start, end) 的全部物理内存（通常为 _end 到 DRAM 末尾）
+ * 2. 二进制伙伴系统（buddy）：空闲块按阶（order 0..MAX_ORDER）组织，
+ *    第 k 阶的块包含 2^k 个物理连续的页，且按块大小对齐
+ * 3. 分配时从最小可用阶取块并逐级对半拆分，释放时与伙伴逐级合并
+ *
  * 核心设计决策：
- * - 静态池：简单可靠，适合实验环境
- * - 栈式分配：O(1)时间复杂度
- * - 固定大小：只支持页级分配，避免碎片问题
+ * - 空闲链表侵入式存放在空闲页内部，不额外占用内存，摘链 O(1)
+ * - 每页一个 8 字节元数据项（struct page），数组放在管理区开头；
+ *   只记录块首页的阶与状态，初始化时不逐页清零
+ * - 拆分/合并最多 MAX_ORDER 次：O(log n)
+ * - alloc_page/free_page 只是 0 阶分配的包装
+ * - 0 阶分配先走每个 hart 的页弹匣（magazine，小型 LIFO 缓存），
+ *   命中时不碰全局锁；空了批量补充、满了批量归还全局伙伴池
+ * - 每个弹匣另有一组预清零页，由空闲循环调用 pmm_zero_refill 补充；
+ *   alloc_page 优先从中取页，清零开销移出分配的关键路径
+ * - 块首页带引用计数：分配时为 1，page_ref_inc 增加共享者（如写时复制），
+ *   释放只是减一，最后一个引用释放时才真正归还
+ * - 页清零统一走 clear_pages：启动时探测到 Zicboz 则用 cbo.zero 按 cache block
+ *   清零，否则按 64 位字写入
+ * - 分配/释放路径不调用 printf（串口逐字节忙等）：只累加每 hart 的事件计数，
+ *   需要审计时打开事件日志，记录写入内存环形缓冲，由 pmm_log_dump 按需输出
  */
 
 #include "pmm.h"
 #include "printf.h"
+#include "riscv.h"
 #include <stdint.h>
 #include <stddef.h>
 
-#define MAX_PAGES 64   /* 最大页数：64 页 = 256 KB */
-#define PAGE_SIZE 4096 /* 页大小：4KB（与硬件页表一致） */
+#define PAGE_SIZE 4096 /* 页大小：4KB（与硬件页大小一致） */
+#define PAGE_SHIFT 12
+
+/*
+ * 页元数据：仅块首页的内容有意义。
+ * 非首页的元数据从未被读取——伙伴页在被检查之前一定在拆分时写过，
+ * 因此元数据区无需在启动时整体清零。
+ */
+struct page {
+    uint8_t order;   /* 块的阶 */
+    uint8_t flags;   /* PG_FREE / PG_HEAD */
+    int refcnt;      /* 已分配块的引用数（仅 PG_HEAD 时有意义） */
+};
+#define PG_FREE 0x1  /* 空闲块首页（挂在 free_area[order] 上） */
+#define PG_HEAD 0x2  /* 已分配块首页 */
+#define PG_MAG  0x4  /* 缓存在某个 hart 的页弹匣中 */
+
+static struct page *page_meta;  /* 元数据数组，下标 = pfn - base_pfn */
+
+/* 空闲块链表节点：直接写在空闲块的第一页里 */
+struct free_block {
+    struct free_block *next;
+    struct free_block *prev;
+};
+
+/* 每阶一个带哨兵的双向循环链表 */
+static struct free_block free_area[MAX_ORDER + 1];
+static int nr_free[MAX_ORDER + 1];
+
+static uint64_t base_pfn;    /* 管理区首页页号（绝对页号 = 物理地址 >> 12） */
+static uint64_t end_pfn;     /* 管理区末页之后的页号 */
+static uint64_t nr_free_pages;  /* 伙伴池中的空闲页数（不含弹匣） */
+
+/*
+ * 全局伙伴池锁：保护 free_area/nr_free/nr_free_pages。
+ * 必须关中断持有：弹匣补充/归还在关中断状态下取这把锁，若持锁者被
+ * 时钟中断抢占，同一 hart 上的下一个进程会关着中断空转，永远等不到释放
+ */
+static volatile int pmm_lock_word;
+
+static inline void pmm_lock(void) {
+    while (__sync_lock_test_and_set(&pmm_lock_word, 1)) {
+        /* spin */
+    }
+}
+
+static inline void pmm_unlock(void) {
+    __sync_lock_release(&pmm_lock_word);
+}
+
+/*
+ * 每 hart 页弹匣：只被所属 hart 访问，操作期间关中断即可，
+ * 不需要任何锁。按 cache line 对齐避免不同 hart 之间伪共享。
+ */
+#ifndef NCPU
+#define NCPU 8
+#endif
+#define MAG_SIZE  32   /* 每个弹匣最多缓存的页数 */
+#define MAG_BATCH 16   /* 一次补充/归还的页数 */
+#define ZERO_MAG_SIZE 32  /* 每个 hart 预清零页数上限 */
+
+struct magazine {
+    void *pages[MAG_SIZE];
+    int count;
+    void *zeroed[ZERO_MAG_SIZE];  /* 预清零页（内容全 0） */
+    int nzeroed;
+    uint64_t hits;     /* 直接从弹匣取到页 */
+    uint64_t misses;   /* 弹匣为空 */
+    uint64_t refills;  /* 从伙伴池批量补充 */
+    uint64_t drains;   /* 向伙伴池批量归还 */
+    uint64_t zero_hits;    /* 清零请求直接拿到预清零页 */
+    uint64_t zero_misses;  /* 预清零页用完，同步清零 */
+    uint64_t events[PMM_EV_NR];  /* 分配事件计数，见 enum pmm_event */
+} __attribute__((aligned(64)));
+
+static struct magazine mags[NCPU];
+
+/*
+ * 分配事件日志：固定大小的环形缓冲，写满后覆盖最旧的记录。
+ * 默认关闭；关闭时热路径只多一次对 pmm_log_on 的读取。
+ */
+#define PMM_LOG_SIZE 256
+
+struct pmm_log_entry {
+    uint64_t cycle;   /* 事件发生时的 cycle 计数 */
+    void *addr;       /* 块首地址（分配失败时为NULL） */
+    uint8_t event;    /* enum pmm_event */
+    uint8_t order;
+    uint8_t hart;
+};
+
+static struct pmm_log_entry pmm_log[PMM_LOG_SIZE];
+static uint64_t pmm_log_next;   /* 下一条记录的序号（单调递增） */
+static volatile int pmm_log_on;
+
+static const char *pmm_event_name[PMM_EV_NR] = {
+    "alloc", "alloc-fail", "free", "bad-free",
+};
 
-/* 静态内存池：位于内核数据段，4KB对齐确保页表使用 */
-static unsigned char memory_pool[MAX_PAGES * PAGE_SIZE] __attribute__((aligned(4096)));
 
-/* 空闲页栈：存储空闲页面的指针列表，free_count表示栈顶 */
-static void *free_list[MAX_PAGES];
-static int free_count = 0;
+static inline uint64_t addr_to_pfn(void *p) { return (uint64_t)p >> PAGE_SHIFT; }
+static inline void *pfn_to_addr(uint64_t pfn) { return (void*)(pfn << PAGE_SHIFT); }
+static inline struct page *pfn_to_meta(uint64_t pfn) { return &page_meta[pfn - base_pfn]; }
+
+static void list_push(int order, uint64_t pfn) {
+    struct free_block *b = (struct free_block*)pfn_to_addr(pfn);
+    struct free_block *head = &free_area[order];
+    b->next = head->next;
+    b->prev = head;
+    head->next->prev = b;
+    head->next = b;
+    nr_free[order]++;
+
+    struct page *m = pfn_to_meta(pfn);
+    m->order = (uint8_t)order;
+    m->flags = PG_FREE;
+}
+
+static void list_remove(int order, uint64_t pfn) {
+    struct free_block *b = (struct free_block*)pfn_to_addr(pfn);
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+    nr_free[order]--;
+    pfn_to_meta(pfn)->flags = 0;
+}
+
+static uint64_t list_pop(int order) {
+    struct free_block *b = free_area[order].next;
+    uint64_t pfn = addr_to_pfn(b);
+    list_remove(order, pfn);
+    return pfn;
+}
+
+/*
+ * pmm_event - 记录一次分配事件
+ *
+ * 计数器属于本 hart，关中断后直接累加，不需要原子操作；
+ * 日志槽位用原子自增抢占，多个 hart 同时记录互不覆盖
+ */
+static void pmm_event(int ev, void *addr, int order) {
+    uint64_t s = intr_save();
+    int hart = cpuid();
+    mags[hart].events[ev]++;
+    intr_restore(s);
+
+    if (!pmm_log_on) return;
+    uint64_t seq = __sync_fetch_and_add(&pmm_log_next, 1);
+    struct pmm_log_entry *e = &pmm_log[seq % PMM_LOG_SIZE];
+    e->cycle = r_cycle();
+    e->addr = addr;
+    e->event = (uint8_t)ev;
+    e->order = (uint8_t)order;
+    e->hart = (uint8_t)hart;
+}
+
+/* Zicboz cache block 大小，0 表示未启用，由 pmm_set_cbo_block 在启动时设置 */
+static int cbo_block;
+
+/**
+ * pmm_set_cbo_block - 选择页清零方式
+ *
+ * 参数：size - zicboz_probe 得到的 cache block 大小；0 或不能整除页大小时
+ *       退回 64 位字写入
+ */
+void pmm_set_cbo_block(int size) {
+    cbo_block = (size > 0 && !(size & (size - 1)) && PAGE_SIZE % size == 0) ? size : 0;
+}
+
+int pmm_cbo_block(void) {
+    return cbo_block;
+}
+
+/**
+ * clear_pages - 清零 n 页内容（p 页对齐）
+ *
+ * cbo.zero 一条指令清零一整个 cache block，不需要先把块读进缓存；
+ * 否则每次循环写 8 个 64 位字
+ */
+void clear_pages(void *p, uint64_t n) {
+    if (cbo_block) {
+        for (char *q = p, *end = q + n * PAGE_SIZE; q < end; q += cbo_block) {
+            cbo_zero(q);
+        }
+        return;
+    }
+    uint64_t *w = (uint64_t*)p;
+    for (uint64_t i = 0; i < n * (PAGE_SIZE / sizeof(uint64_t)); i += 8) {
+        w[i] = 0; w[i + 1] = 0; w[i + 2] = 0; w[i + 3] = 0;
+        w[i + 4] = 0; w[i + 5] = 0; w[i + 6] = 0; w[i + 7] = 0;
+    }
+}
 
 /**
  * pmm_init - 初始化物理内存管理器
- * 
- * 将所有页面添加到空闲列表，形成初始状态
+ *
+ * 参数：[start, end) - 可用物理内存范围（start 通常为内核的 _end）
+ *
+ * 布局：
+ *   start (页对齐) | struct page 元数据数组 | 页对齐后的可分配区 ... end
+ *
+ * 元数据数组先整体清零：buddy_free、page_head 等会读任意页的 flags/order/引用数，
+ * 不能假定启动时内存为零。之后把可分配区切成尽可能大的对齐块挂入对应阶的空闲链表，
+ * 只有块首页的元数据需要再写。
  */
 void pmm_init(uint64_t start, uint64_t end) {
-    (void)start; // 未使用参数（目前我们用的是内核静态池）
-    (void)end;
+    start = (start + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+    end &= ~((uint64_t)PAGE_SIZE - 1);
+    if (end <= start) {
+        printf("pmm_init: invalid range %p - %p\n", (void*)start, (void*)end);
+        return;
+    }
+
+    for (int o = 0; o <= MAX_ORDER; o++) {
+        free_area[o].next = free_area[o].prev = &free_area[o];
+        nr_free[o] = 0;
+    }
+
+    /* 元数据数组占用管理区开头的若干页 */
+    uint64_t total = (end - start) >> PAGE_SHIFT;
+    uint64_t meta_pages = (total * sizeof(struct page) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    page_meta = (struct page*)start;
+    clear_pages(page_meta, meta_pages);
+    base_pfn = addr_to_pfn((void*)start) + meta_pages;
+    end_pfn = addr_to_pfn((void*)end);
+    nr_free_pages = 0;
+
+    uint64_t pfn = base_pfn;
+    while (pfn < end_pfn) {
+        int order = MAX_ORDER;
+        /* 取满足“按块对齐且不越界”的最大阶 */
+        while (order > 0 &&
+               ((pfn & ((1UL << order) - 1)) || pfn + (1UL << order) > end_pfn)) {
+            order--;
+        }
+        list_push(order, pfn);
+        nr_free_pages += 1UL << order;
+        pfn += 1UL << order;
+    }
+
+    printf("PMM initialized: %p - %p, %d pages (%d KB), %d metadata pages, "
+           "largest block order %d\n",
+           pfn_to_addr(base_pfn), (void*)end, (int)nr_free_pages,
+           (int)(nr_free_pages * PAGE_SIZE / 1024), (int)meta_pages,
+           pmm_largest_free_order());
+    if (cbo_block) printf("PMM page clear: Zicboz cbo.zero, %d-byte blocks\n", cbo_block);
+    else printf("PMM page clear: 64-bit word stores\n");
+}
+
+/*
+ * buddy_alloc - 从伙伴池取出 2^order 页（调用者持有 pmm_lock）
+ *
+ * 实现：找到不小于 order 的最小非空阶，取出一块后逐级对半拆分，
+ *      每次把后一半（伙伴）挂回低一阶的空闲链表
+ */
+static void *buddy_alloc(int order) {
+    int k = order;
+    while (k <= MAX_ORDER && nr_free[k] == 0) k++;
+    if (k > MAX_ORDER) return NULL;
+
+    uint64_t pfn = list_pop(k);
+    while (k > order) {
+        k--;
+        list_push(k, pfn + (1UL << k));
+    }
+
+    struct page *m = pfn_to_meta(pfn);
+    m->order = (uint8_t)order;
+    m->flags = PG_HEAD;
+    nr_free_pages -= 1UL << order;
+    return pfn_to_addr(pfn);
+}
 
-    free_count = 0;
+/*
+ * buddy_free - 把块还给伙伴池（调用者持有 pmm_lock，块已通过检查）
+ *
+ * 合并：伙伴页号 = pfn ^ 2^order；伙伴空闲且同阶时摘下合并，继续向上
+ */
+static void buddy_free(uint64_t pfn, int order) {
+    pfn_to_meta(pfn)->flags = 0;
+    nr_free_pages += 1UL << order;
 
-    /* 遍历内存池，将每个页添加到空闲列表 */
-    for (int i = 0; i < MAX_PAGES; i++) {
-        void *page = (void*)&memory_pool[i * PAGE_SIZE];
-        free_list[free_count++] = page;
+    while (order < MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1UL << order);
+        if (buddy < base_pfn || buddy + (1UL << order) > end_pfn) break;
+        struct page *bm = pfn_to_meta(buddy);
+        if (bm->flags != PG_FREE || bm->order != order) break;
+        list_remove(order, buddy);
+        pfn &= ~(1UL << order);
+        order++;
     }
+    list_push(order, pfn);
+}
+
+/*
+ * mag_alloc - 从本 hart 的弹匣取一页
+ *
+ * 弹匣为空时持锁从伙伴池一次取 MAG_BATCH 页，摊薄加锁开销
+ */
+static void *mag_alloc(void) {
+    uint64_t s = intr_save();
+    struct magazine *m = &mags[cpuid()];
 
-    printf("PMM initialized: %d pages (%d KB)\n",
-           MAX_PAGES, (MAX_PAGES * PAGE_SIZE) / 1024);
+    if (m->count > 0) {
+        m->hits++;
+    } else {
+        m->misses++;
+        pmm_lock();
+        while (m->count < MAG_BATCH) {
+            void *p = buddy_alloc(0);
+            if (!p) break;
+            pfn_to_meta(addr_to_pfn(p))->flags = PG_MAG;
+            m->pages[m->count++] = p;
+        }
+        pmm_unlock();
+        if (m->count > 0) m->refills++;
+    }
+
+    void *p = NULL;
+    if (m->count > 0) {
+        p = m->pages[--m->count];
+        pfn_to_meta(addr_to_pfn(p))->flags = PG_HEAD;
+    }
+    intr_restore(s);
+    return p;
+}
+
+/*
+ * mag_free - 把一页放回本 hart 的弹匣
+ *
+ * 弹匣已满时把最旧的 MAG_BATCH 页批量还给伙伴池，保留最近释放的热页
+ */
+static void mag_free(void *page) {
+    uint64_t s = intr_save();
+    struct magazine *m = &mags[cpuid()];
+
+    if (m->count == MAG_SIZE) {
+        pmm_lock();
+        for (int i = 0; i < MAG_BATCH; i++) {
+            buddy_free(addr_to_pfn(m->pages[i]), 0);
+        }
+        pmm_unlock();
+        for (int i = MAG_BATCH; i < MAG_SIZE; i++) {
+            m->pages[i - MAG_BATCH] = m->pages[i];
+        }
+        m->count -= MAG_BATCH;
+        m->drains++;
+    }
+    pfn_to_meta(addr_to_pfn(page))->flags = PG_MAG;
+    m->pages[m->count++] = page;
+    intr_restore(s);
+}
+
+/* zero_mag_pop - 从本 hart 的预清零页中取一页，没有则返回NULL */
+static void *zero_mag_pop(void) {
+    uint64_t s = intr_save();
+    struct magazine *m = &mags[cpuid()];
+    void *p = NULL;
+    if (m->nzeroed > 0) {
+        p = m->zeroed[--m->nzeroed];
+        pfn_to_meta(addr_to_pfn(p))->flags = PG_HEAD;
+        m->zero_hits++;
+    } else {
+        m->zero_misses++;
+    }
+    intr_restore(s);
+    return p;
 }
 
 /**
- * alloc_page - 分配一个物理页
- * 
- * 返回：分配成功返回页对齐的地址，失败返回NULL
- * 
- * 实现：从栈顶弹出页面，并清零
+ * pmm_zero_refill - 补充本 hart 的预清零页（供空闲循环调用）
+ *
+ * 参数：budget - 本次最多清零的页数，限制单次占用 CPU 的时间
+ * 返回：本次清零的页数
+ *
+ * 页从伙伴池一次性取出；清零在开中断状态下进行，不阻塞中断
  */
-void* alloc_page(void) {
-    if (free_count <= 0) {
-        printf("pmm: out of memory!\n");
-        return NULL;
+int pmm_zero_refill(int budget) {
+    uint64_t s = intr_save();
+    struct magazine *m = &mags[cpuid()];
+    int want = ZERO_MAG_SIZE - m->nzeroed;
+    if (want > budget) want = budget;
+    if (want <= 0) {
+        intr_restore(s);
+        return 0;
+    }
+
+    /* 取页和下面的归还都关中断持锁，见 pmm_lock */
+    void *batch[ZERO_MAG_SIZE];
+    int n = 0;
+    pmm_lock();
+    while (n < want) {
+        void *p = buddy_alloc(0);
+        if (!p) break;
+        pfn_to_meta(addr_to_pfn(p))->flags = PG_MAG;
+        batch[n++] = p;
     }
-    void *page = free_list[--free_count]; // 栈式分配：从栈顶取页
-    // 清零页内容（安全性考虑）
-    for (int i = 0; i < PAGE_SIZE; i++) {
-        ((unsigned char*)page)[i] = 0;
+    pmm_unlock();
+    intr_restore(s);
+
+    for (int i = 0; i < n; i++) clear_pages(batch[i], 1);
+
+    /* 清零期间可能被调度到别的 hart，放不下的页还给伙伴池 */
+    s = intr_save();
+    m = &mags[cpuid()];
+    int i = 0;
+    while (i < n && m->nzeroed < ZERO_MAG_SIZE) m->zeroed[m->nzeroed++] = batch[i++];
+    if (i < n) {
+        pmm_lock();
+        for (int j = i; j < n; j++) buddy_free(addr_to_pfn(batch[j]), 0);
+        pmm_unlock();
     }
-    printf("pmm: alloc_page -> %p (remain=%d)\n", page, free_count);
-    return page;
+    intr_restore(s);
+    return i;
 }
 
 /**
- * free_page - 释放一个物理页
- * 
- * 参数：page - 需要释放的页地址
- * 
+ * alloc_pages_flags - 分配 2^order 个物理连续页
+ *
+ * 参数：flags - PMM_ZERO 表示需要清零的页，否则内容未定义
+ * 返回：块首地址（按 2^order 页对齐），失败返回NULL
+ *
+ * 0 阶走本 hart 弹匣（清零请求优先取预清零页）；更高阶直接持锁访问伙伴池
+ */
+void* alloc_pages_flags(int order, int flags) {
+    if (order < 0 || order > MAX_ORDER) return NULL;
+
+    void *p;
+    if (order == 0) {
+        if ((flags & PMM_ZERO) && (p = zero_mag_pop()) != NULL) {
+            pfn_to_meta(addr_to_pfn(p))->refcnt = 1;
+            pmm_event(PMM_EV_ALLOC, p, 0);
+            return p;
+        }
+        p = mag_alloc();
+    } else {
+        uint64_t s = intr_save();
+        pmm_lock();
+        p = buddy_alloc(order);
+        pmm_unlock();
+        intr_restore(s);
+    }
+    if (!p) {
+        pmm_event(PMM_EV_ALLOC_FAIL, NULL, order);
+        return NULL;
+    }
+    pfn_to_meta(addr_to_pfn(p))->refcnt = 1;
+    if (flags & PMM_ZERO) clear_pages(p, 1UL << order);
+    pmm_event(PMM_EV_ALLOC, p, order);
+    return p;
+}
+
+/* alloc_pages_order - 分配 2^order 个清零的连续页 */
+void* alloc_pages_order(int order) {
+    return alloc_pages_flags(order, PMM_ZERO);
+}
+
+/**
+ * free_pages_order - 释放 2^order 页的块（放弃一个引用）
+ *
+ * 块被多方共享时只把引用数减一；最后一个引用释放时才归还内存
+ *
  * 安全检查：
- * 1. 检查地址是否在内存池范围内
- * 2. 检查地址是否页对齐
- * 3. 检查是否重复释放
+ * 1. 检查地址是否在管理区范围内
+ * 2. 检查地址是否按块大小对齐
+ * 3. 检查是否为已分配块的首页且阶数一致（防止重复释放）
+ *
+ * 检查失败说明调用者有 bug，此时才输出诊断信息
  */
-void free_page(void* page) {
+void free_pages_order(void* page, int order) {
     if (!page) return;
 
     uintptr_t addr = (uintptr_t)page;
-    uintptr_t pool_start = (uintptr_t)memory_pool;
-    uintptr_t pool_end   = pool_start + (MAX_PAGES * PAGE_SIZE);
+    uint64_t pfn = addr_to_pfn(page);
 
-    /* 安全检查1：地址必须在内存池范围内 */
-    if (addr < pool_start || addr >= pool_end) {
-        printf("pmm: free_page: address %p out of pool\n", page);
+    /* 安全检查1：地址必须在管理区范围内 */
+    if (order < 0 || order > MAX_ORDER ||
+        pfn < base_pfn || pfn + (1UL << order) > end_pfn) {
+        printf("pmm: free_pages: address %p out of pool\n", page);
+        pmm_event(PMM_EV_BAD_FREE, page, order);
+        return;
+    }
+    /* 安全检查2：地址必须按块大小对齐 */
+    if (addr & ((PAGE_SIZE << order) - 1)) {
+        printf("pmm: free_pages: address %p not aligned\n", page);
+        pmm_event(PMM_EV_BAD_FREE, page, order);
         return;
     }
-    /* 安全检查2：地址必须4KB对齐 */
-    if (addr % PAGE_SIZE != 0) {
-        printf("pmm: free_page: address %p not aligned\n", page);
+    /* 安全检查3：必须是已分配块的首页 */
+    struct page *m = pfn_to_meta(pfn);
+    if (m->flags != PG_HEAD || m->order != order) {
+        printf("pmm: free_pages: %p not an allocated order-%d block (double free?)\n",
+               page, order);
+        pmm_event(PMM_EV_BAD_FREE, page, order);
         return;
     }
-    /* 安全检查3：检测重复释放 */
-    if (free_count >= MAX_PAGES) {
-        printf("pmm: free_page: free list full (double free?)\n");
+
+    if (__sync_sub_and_fetch(&m->refcnt, 1) > 0) return;
+
+    pmm_event(PMM_EV_FREE, page, order);
+    if (order == 0) {
+        mag_free(page);
+        return;
+    }
+    uint64_t s = intr_save();
+    pmm_lock();
+    buddy_free(pfn, order);
+    pmm_unlock();
+    intr_restore(s);
+}
+
+/**
+ * alloc_page - 分配一个物理页
+ *
+ * 返回：分配成功返回页对齐的地址，失败返回NULL
+ *
+ * 实现：0 阶分配，页内容已清零（优先使用预清零页）
+ *      内存不足时只记 PMM_EV_ALLOC_FAIL 事件，由调用者处理NULL
+ */
+void* alloc_page(void) {
+    return alloc_pages_flags(0, PMM_ZERO);
+}
+
+/**
+ * alloc_page_nozero - 分配一个内容未定义的物理页
+ *
+ * 用于马上会被整页覆盖的场景（如复制页内容），省去清零
+ */
+void* alloc_page_nozero(void) {
+    return alloc_pages_flags(0, 0);
+}
+
+/**
+ * free_page - 释放一个物理页
+ *
+ * 参数：page - 需要释放的页地址
+ */
+void free_page(void* page) {
+    free_pages_order(page, 0);
+}
+
+/* page_head - 返回 page 所在已分配块的首页元数据，page 不在管理区或不是块首时返回NULL */
+static struct page *page_head(void *page) {
+    uint64_t pfn = addr_to_pfn(page);
+    if (pfn < base_pfn || pfn >= end_pfn) return NULL;
+    struct page *m = pfn_to_meta(pfn);
+    return m->flags == PG_HEAD ? m : NULL;
+}
+
+/* pmm_managed - 物理地址是否属于 PMM 管理区（可以参与引用计数） */
+int pmm_managed(uint64_t pa) {
+    uint64_t pfn = pa >> PAGE_SHIFT;
+    return pfn >= base_pfn && pfn < end_pfn;
+}
+
+/**
+ * page_ref_inc - 为已分配的块增加一个引用
+ *
+ * 每个引用都要对应一次 free_page/free_pages_order
+ */
+void page_ref_inc(void *page) {
+    struct page *m = page_head(page);
+    if (!m) {
+        printf("pmm: page_ref_inc: %p is not an allocated block\n", page);
         return;
     }
+    __sync_fetch_and_add(&m->refcnt, 1);
+}
 
-    /* 将页压入空闲栈 */
-    free_list[free_count++] = page;
-    printf("pmm: free_page <- %p (remain=%d)\n", page, free_count);
+/* page_ref_count - 块的当前引用数，非已分配块返回 0 */
+int page_ref_count(void *page) {
+    struct page *m = page_head(page);
+    return m ? m->refcnt : 0;
+}
+
+/* n 页向上取整到 2 的幂对应的阶；超过最大块（2^MAX_ORDER 页）返回 -1 */
+static int pages_to_order(int n) {
+    if (n > (1 << MAX_ORDER)) return -1;
+    int order = 0;
+    while ((1 << order) < n) order++;
+    return order;
 }
 
 /**
- * alloc_pages - 分配n个连续的物理页（用于页表结构）
- * 
- * 参数：n - 需要分配的页数
- * 返回：返回第一页的地址，失败返回NULL
- * 
- * 注意：虽然叫做"连续"，但实际不保证物理连续
- *      只是分配了n个页面，用于页表树结构
+ * alloc_pages - 分配n个物理连续的页
+ *
+ * 参数：n - 需要分配的页数（向上取整到 2 的幂）
+ * 返回：块首地址，失败返回NULL
+ *
+ * 返回的内存保证物理连续，可用于 DMA 缓冲区、大页和内核栈
  */
 void* alloc_pages(int n) {
     if (n <= 0) return NULL;
-    if (free_count < n) {
-        printf("pmm: alloc_pages(%d) failed (only %d free)\n", n, free_count);
-        return NULL;
+    int order = pages_to_order(n);
+    if (order < 0) return NULL;
+    return alloc_pages_order(order);
+}
+
+/**
+ * free_pages - 释放 alloc_pages(n) 返回的块
+ */
+void free_pages(void* page, int n) {
+    if (n <= 0) return;
+    int order = pages_to_order(n);
+    if (order < 0) {
+        printf("pmm: free_pages: %d pages is larger than any block\n", n);
+        return;
     }
+    free_pages_order(page, order);
+}
 
-    void *first = NULL;
-    for (int i = 0; i < n; i++) {
-        void *p = alloc_page();
-        if (!p) {
-            /* 失败回滚：释放已分配的所有页 */
-            for (int j = 0; j < i; j++) {
-                free_page(((void**)free_list)[free_count]);
-            }
-            return NULL;
-        }
-        if (i == 0) first = p;
+/* 空闲页总数：伙伴池 + 各 hart 弹匣 */
+uint64_t pmm_free_pages(void) {
+    uint64_t n = nr_free_pages;
+    for (int i = 0; i < NCPU; i++) {
+        n += mags[i].count + mags[i].nzeroed;
+    }
+    return n;
+}
+
+/* 当前可分配的最大连续块的阶，无空闲内存时返回 -1 */
+int pmm_largest_free_order(void) {
+    for (int o = MAX_ORDER; o >= 0; o--) {
+        if (nr_free[o]) return o;
+    }
+    return -1;
+}
+
+void pmm_dump(void) {
+    printf("pmm: free=%d pages, per-order:", (int)nr_free_pages);
+    for (int o = 0; o <= MAX_ORDER; o++) {
+        printf(" %d", nr_free[o]);
+    }
+    printf("\n");
+    if (cbo_block) printf("pmm: page clear: cbo.zero, %d-byte blocks\n", cbo_block);
+    else printf("pmm: page clear: word stores\n");
+
+    for (int i = 0; i < NCPU; i++) {
+        struct magazine *m = &mags[i];
+        uint64_t total = m->hits + m->misses;
+        uint64_t ztotal = m->zero_hits + m->zero_misses;
+        if (total == 0 && ztotal == 0 && m->count == 0 && m->nzeroed == 0) continue;
+        printf("pmm: hart %d magazine: cached=%d hits=%d misses=%d hit-rate=%d%% "
+               "refills=%d drains=%d\n",
+               i, m->count, (int)m->hits, (int)m->misses,
+               total ? (int)(m->hits * 100 / total) : 0,
+               (int)m->refills, (int)m->drains);
+        printf("pmm: hart %d zeroed pool: cached=%d hits=%d misses=%d\n",
+               i, m->nzeroed, (int)m->zero_hits, (int)m->zero_misses);
+    }
+
+    printf("pmm: events:");
+    for (int ev = 0; ev < PMM_EV_NR; ev++) {
+        printf(" %s=%d", pmm_event_name[ev], (int)pmm_event_count(ev));
+    }
+    printf("\n");
+}
+
+/* pmm_event_count - 某类事件在所有 hart 上的累计次数 */
+uint64_t pmm_event_count(int ev) {
+    if (ev < 0 || ev >= PMM_EV_NR) return 0;
+    uint64_t n = 0;
+    for (int i = 0; i < NCPU; i++) n += mags[i].events[ev];
+    return n;
+}
+
+/**
+ * pmm_log_enable - 打开/关闭分配事件日志
+ *
+ * 打开时清空旧记录，日志只反映打开之后的事件
+ */
+void pmm_log_enable(int on) {
+    if (on) pmm_log_next = 0;
+    __sync_synchronize();
+    pmm_log_on = on;
+}
+
+/**
+ * pmm_log_dump - 按时间顺序输出日志中保留的记录
+ *
+ * 缓冲区写满后只保留最近 PMM_LOG_SIZE 条；cycle 以第一条为基准输出差值。
+ * 应在日志关闭或没有并发分配时调用，否则可能读到正在写入的记录
+ */
+void pmm_log_dump(void) {
+    uint64_t next = pmm_log_next;
+    uint64_t first = next > PMM_LOG_SIZE ? next - PMM_LOG_SIZE : 0;
+    printf("pmm log: %d events recorded, showing %d\n",
+           (int)next, (int)(next - first));
+    if (next == first) return;
+
+    uint64_t t0 = pmm_log[first % PMM_LOG_SIZE].cycle;
+    for (uint64_t seq = first; seq < next; seq++) {
+        struct pmm_log_entry *e = &pmm_log[seq % PMM_LOG_SIZE];
+        const char *name = e->event < PMM_EV_NR ? pmm_event_name[e->event] : "?";
+        printf("  +%d hart %d %s order %d %p\n",
+               (int)(e->cycle - t0), e->hart, name, e->order, e->addr);
     }
-    return first;
 }
@@ -0,0 +1,126 @@
+#ifndef RISCV_H
+#define RISCV_H
+
+#include <stdint.h>
+
+#define SSTATUS_SIE (1UL << 1)
+
+/* hart 号保存在 tp 中（由 entry.S 设置） */
+static inline uint64_t r_tp(void) {
+    uint64_t x;
+    asm volatile("mv %0, tp" : "=r"(x));
+    return x;
+}
+
+static inline int cpuid(void) {
+    return (int)r_tp();
+}
+
+static inline uint64_t r_cycle(void) {
+    uint64_t x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+/*
+ * mstatus.MPRV：置位后 M 模式的 load/store 按 MPP 指定的特权级做地址翻译
+ * （取指不受影响），M 模式内核借此在 satp 页表下访问内存
+ */
+#define MSTATUS_MPP_MASK (3UL << 11)
+#define MSTATUS_MPP_S    (1UL << 11)
+#define MSTATUS_MPRV     (1UL << 17)
+
+static inline uint64_t r_mstatus(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mstatus" : "=r"(x));
+    return x;
+}
+
+static inline void w_mstatus(uint64_t x) {
+    asm volatile("csrw mstatus, %0" :: "r"(x) : "memory");
+}
+
+/* PMP 第 0 项：S/U 模式的访问至少要命中一项 PMP 才被允许 */
+static inline void w_pmpaddr0(uint64_t x) {
+    asm volatile("csrw pmpaddr0, %0" :: "r"(x));
+}
+
+static inline void w_pmpcfg0(uint64_t x) {
+    asm volatile("csrw pmpcfg0, %0" :: "r"(x));
+}
+
+/* Zicboz：把 addr 所在的整个 cache block 清零（用 .insn 编码，不依赖汇编器支持） */
+static inline void cbo_zero(void *addr) {
+    asm volatile(".insn i 0x0F, 2, x0, %0, 4" :: "r"(addr) : "memory");
+}
+
+/*
+ * zicboz_probe - 探测 Zicboz，返回 cache block 大小，不支持时返回 0
+ *
+ * 只能在 M 模式调用。menvcfg.CBZE 只有实现了 Zicboz 才可写，置位同时
+ * 允许 S 模式使用 cbo.zero。再对填满 0xFF 的缓冲执行一次 cbo.zero，
+ * 被清零的字节数就是 block 大小。buf 至少 size 字节并按 size 对齐
+ */
+#define MENVCFG_CBZE (1UL << 7)
+#define CBO_PROBE_MAX 512
+
+static inline int zicboz_probe(uint8_t *buf) {
+    /*
+     * menvcfg 是特权架构 1.12 才有的 CSR，更早的 hart 上访问它触发非法指令异常。
+     * 探测期间 mtvec 临时指向一段只跳过出错指令的处理程序，此时 cfg 保持 0
+     */
+    uint64_t cfg = 0, old_mtvec, old_mstatus;
+    asm volatile("csrrci %2, mstatus, 8\n\t"  /* 关 MIE：临时处理程序只处理异常 */
+                 "la    t0, 1f\n\t"
+                 "csrrw %1, mtvec, t0\n\t"
+                 "csrs  0x30a, %3\n\t"
+                 "csrr  %0, 0x30a\n\t"
+                 "j     2f\n\t"
+                 ".align 2\n"
+                 "1:\n\t"
+                 "csrr  t0, mepc\n\t"
+                 "addi  t0, t0, 4\n\t"
+                 "csrw  mepc, t0\n\t"
+                 "mret\n"
+                 "2:\n\t"
+                 "csrw  mtvec, %1\n\t"
+                 "csrw  mstatus, %2"
+                 : "+r"(cfg), "=&r"(old_mtvec), "=&r"(old_mstatus)
+                 : "r"(MENVCFG_CBZE) : "t0", "memory");
+    if (!(cfg & MENVCFG_CBZE)) return 0;
+    for (int i = 0; i < CBO_PROBE_MAX; i++) buf[i] = 0xFF;
+    cbo_zero(buf);
+    int n = 0;
+    while (n < CBO_PROBE_MAX && buf[n] == 0) n++;
+    return n;
+}
+
+/*
+ * 写SATP寄存器（启用/禁用MMU）
+ * 格式：[63:60] MODE（8 = Sv39，9 = Sv48） | [59:44] ASID | [43:0] 根页表物理页号
+ */
+static inline void w_satp(uint64_t satp) {
+    asm volatile("csrw satp, %0" :: "r"(satp));
+}
+
+/* 刷新整个 TLB，或只刷新某个虚拟地址对应的表项 */
+static inline void sfence_vma_all(void) {
+    asm volatile("sfence.vma zero, zero" ::: "memory");
+}
+
+static inline void sfence_vma_va(uint64_t va) {
+    asm volatile("sfence.vma %0, zero" :: "r"(va) : "memory");
+}
+
+/* 关中断并返回之前的 SIE 位；与 intr_restore 配对保护 per-CPU 数据 */
+static inline uint64_t intr_save(void) {
+    uint64_t old;
+    asm volatile("csrrc %0, sstatus, %1" : "=r"(old) : "r"(SSTATUS_SIE) : "memory");
+    return old & SSTATUS_SIE;
+}
+
+static inline void intr_restore(uint64_t old) {
+    if (old) asm volatile("csrs sstatus, %0" :: "r"(old) : "memory");
+}
+
+#endif /* RISCV_H */
@@ -0,0 +1,222 @@
+// kernel/kstack.c - 按需增长的内核栈
+//
+// 每个进程在 [KSTACK_BASE, KSTACK_BASE + NPROC * KSTACK_SLOT) 中占一个槽：
+// 最低一页是不映射的保护页，之上 KSTACK_SIZE 字节是栈。创建时只映射
+// 栈顶一页，更深的页在第一次访问时由缺页处理映射，空闲进程只占一页。
+//
+// 缺页处理在每 hart 的缺页栈上运行（见 trapvec.S），不依赖正在增长的栈。
+// 栈增长可能发生在任意深度，包括持有 PMM 锁的时候，所以缺页路径只从
+// 预留页链表取页，预留页在 kstack_alloc 时补充；链表用 CAS 操作，
+// 被缺页打断的补充过程不会丢页。页按 4KB 对齐，链表头的低 12 位存放
+// 修改计数，多个 hart 同时弹出/压入时 CAS 不会受 ABA 影响。
+//
+// 窗口的各级页表（直到 L0）由 kvm_prealloc 预先建好，栈页的映射只改动
+// 共享子表，所有地址空间都能看到。kstack_alloc/kstack_free 经内核页表锁
+// 修改；缺页路径不能拿这把锁（被打断的代码可能正持有它），它只写本槽位
+// 在已存在的 L0 页表中的叶子 PTE，不分配也不释放页表，和持锁的修改互不干扰。
+// 槽位小于 2MB，kstack_free 撤销栈时也不会清空整个 L0 页表。
+#include "kstack.h"
+#include "kvminit.h"
+#include "pmm.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "trap.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdio.h>
+
+#define KSTACK_RESERVE 4  // 预留页数，够一个栈从一页长满
+
+_Static_assert(KSTACK_SIZE < LEVEL_SIZE(1), "kstack_free must never empty an L0 page table");
+
+static uint8_t slot_used[NPROC];
+static struct spinlock slot_lock;
+// 预留页链表：页地址 | 修改计数（低 12 位），链接字放在页的第一个字
+static volatile uint64_t reserve_head;
+static volatile int reserve_count;
+
+#define RESERVE_TAG_MASK ((uint64_t)PAGE_SIZE - 1)
+
+static struct {
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t grows;                      // 缺页映射的栈页
+  uint64_t reserve_misses;             // 预留页用完，退回 alloc_page
+  uint64_t max_high_water;             // 见过的最大栈深（字节）
+  uint64_t hist[KSTACK_PAGES + 1];     // 已释放栈的栈深分布（按页向上取整）
+} kstack_stats;
+
+static inline uint8_t *slot_base(int slot) {
+  return (uint8_t *)(KSTACK_BASE + (uint64_t)slot * KSTACK_SLOT + PAGE_SIZE);
+}
+
+static inline uint64_t reserve_next_tag(uint64_t head) {
+  return (head + 1) & RESERVE_TAG_MASK;
+}
+
+static void reserve_push(void *page) {
+  uint64_t old;
+  do {
+    old = reserve_head;
+    *(void **)page = (void *)(old & ~RESERVE_TAG_MASK);
+  } while (!__sync_bool_compare_and_swap(&reserve_head, old,
+                                         (uint64_t)page | reserve_next_tag(old)));
+  __sync_fetch_and_add(&reserve_count, 1);
+}
+
+static void *reserve_pop(void) {
+  uint64_t old;
+  void *page;
+  do {
+    old = reserve_head;
+    page = (void *)(old & ~RESERVE_TAG_MASK);
+    if (!page) {
+      return NULL;
+    }
+  } while (!__sync_bool_compare_and_swap(&reserve_head, old,
+                                         (uint64_t)*(void **)page | reserve_next_tag(old)));
+  __sync_fetch_and_sub(&reserve_count, 1);
+  *(void **)page = NULL;
+  return page;
+}
+
+static void reserve_refill(void) {
+  while (reserve_count < KSTACK_RESERVE) {
+    void *page = alloc_page();
+    if (!page) {
+      return;
+    }
+    reserve_push(page);
+  }
+}
+
+void kstack_init(void) {
+  init_lock(&slot_lock, "kstack_slot");
+  if (kvm_prealloc(KSTACK_BASE, NPROC * KSTACK_SLOT, 0) < 0) {
+    panic("kstack_init: cannot reserve kernel stack window");
+  }
+  reserve_refill();
+  printf("kstack: %d slots at %#lx, %d KB cap, 4 KB resident at start\n", NPROC,
+         KSTACK_BASE, KSTACK_SIZE / 1024);
+}
+
+// slot_put: hand a slot back for the next kstack_alloc. Its mappings must
+// be gone from every hart's TLB by now (kvm_unmap_range waits for that).
+static void slot_put(int slot) {
+  acquire(&slot_lock);
+  slot_used[slot] = 0;
+  release(&slot_lock);
+}
+
+// kstack_alloc: claim a free slot and map its top page. Returns the lowest
+// address of the stack (the stack top is base + KSTACK_SIZE), NULL when no
+// slot or page is left.
+uint8_t *kstack_alloc(void) {
+  reserve_refill();
+  int slot = -1;
+  acquire(&slot_lock);
+  for (int i = 0; i < NPROC; ++i) {
+    if (!slot_used[i]) {
+      slot_used[i] = 1;
+      slot = i;
+      break;
+    }
+  }
+  release(&slot_lock);
+  if (slot < 0) {
+    return NULL;
+  }
+  uint8_t *base = slot_base(slot);
+  void *page = alloc_page();
+  if (!page || kvm_map_page((uint64_t)(base + KSTACK_SIZE - PAGE_SIZE), (uint64_t)page,
+                            PTE_R | PTE_W) != 0) {
+    if (page) {
+      free_page(page);
+    }
+    slot_put(slot);
+    return NULL;
+  }
+  __sync_fetch_and_add(&kstack_stats.allocs, 1);
+  return base;
+}
+
+// kstack_high_water: deepest byte of the stack ever written. Pages are
+// zeroed when mapped, so scan the lowest resident page for the first
+// non-zero word.
+uint64_t kstack_high_water(uint8_t *base) {
+  for (uint64_t off = 0; off < KSTACK_SIZE; off += PAGE_SIZE) {
+    pte_t *pte = walk_lookup(kernel_pagetable, (uint64_t)(base + off));
+    if (!pte || !(*pte & PTE_V)) {
+      continue;
+    }
+    const uint64_t *w = (const uint64_t *)(base + off);
+    uint64_t i = 0;
+    while (i < PAGE_SIZE / sizeof(uint64_t) - 1 && w[i] == 0) {
+      ++i;
+    }
+    return KSTACK_SIZE - off - i * sizeof(uint64_t);
+  }
+  return 0;
+}
+
+// kstack_free: record the high-water mark, then unmap the stack and give
+// its pages back. The stack must not be in use.
+void kstack_free(uint8_t *base) {
+  if (!base) {
+    return;
+  }
+  uint64_t hwm = kstack_high_water(base);
+  if (hwm > kstack_stats.max_high_water) {
+    kstack_stats.max_high_water = hwm;
+  }
+  __sync_fetch_and_add(&kstack_stats.hist[(hwm + PAGE_SIZE - 1) / PAGE_SIZE], 1);
+  __sync_fetch_and_add(&kstack_stats.frees, 1);
+
+  // 返回时各 hart 都已刷新 TLB，槽位才能交给下一个 kstack_alloc
+  kvm_unmap_range((uint64_t)base, KSTACK_SIZE, 1);
+  slot_put((int)(((uint64_t)base - KSTACK_BASE) / KSTACK_SLOT));
+}
+
+// kstack_fault: page-fault hook. Returns 0 after mapping a missing page of
+// a live stack, -1 for addresses outside the stack window. A fault on a
+// guard page is a stack overflow and panics.
+int kstack_fault(uint64_t va) {
+  if (va < KSTACK_BASE || va >= KSTACK_BASE + NPROC * KSTACK_SLOT) {
+    return -1;
+  }
+  int slot = (int)((va - KSTACK_BASE) / KSTACK_SLOT);
+  uint64_t off = (va - KSTACK_BASE) % KSTACK_SLOT;
+  if (!slot_used[slot]) {
+    return -1;
+  }
+  if (off < PAGE_SIZE) {
+    printf("kstack: slot %d overflowed %d KB at %#lx\n", slot, KSTACK_SIZE / 1024,
+           (unsigned long)va);
+    panic("kernel stack overflow");
+  }
+  void *page = reserve_pop();
+  if (!page) {
+    __sync_fetch_and_add(&kstack_stats.reserve_misses, 1);
+    page = alloc_page();
+  }
+  // 不拿内核页表锁：L0 页表在 kstack_init 时已建好，这里只写一个叶子 PTE
+  if (!page || map_page(kernel_pagetable, PAGE_ROUND_DOWN(va), (uint64_t)page,
+                        PTE_R | PTE_W | PTE_G) != 0) {
+    panic("kstack: cannot grow kernel stack");
+  }
+  // 无效 -> 有效不需要刷新 TLB
+  __sync_fetch_and_add(&kstack_stats.grows, 1);
+  return 0;
+}
+
+void kstack_dump(void) {
+  printf("kstack: allocs=%lu frees=%lu grows=%lu reserve misses=%lu max high water=%lu B\n",
+         (unsigned long)kstack_stats.allocs, (unsigned long)kstack_stats.frees,
+         (unsigned long)kstack_stats.grows, (unsigned long)kstack_stats.reserve_misses,
+         (unsigned long)kstack_stats.max_high_water);
+  printf("kstack: high water of freed stacks:");
+  for (int i = 0; i <= KSTACK_PAGES; ++i) {
+    printf(" <=%dK:%lu", i * 4, (unsigned long)kstack_stats.hist[i]);
+  }
+  printf("\n");
+}
@@ -0,0 +1,26 @@
+// kernel/kstack.h
+#pragma once
+
+#include <stdint.h>
+#include "pagetable.h"
+#include "proc.h"
+
+// Kernel stacks live in their own VA window with one slot per process.
+// A slot is an unmapped guard page followed by KSTACK_SIZE bytes of stack.
+// Only the top page is mapped when the stack is created; deeper pages are
+// mapped by the page-fault path the first time they are touched. Running
+// into the guard page panics instead of corrupting a neighbour.
+//
+// Pages are zeroed when mapped, so the deepest non-zero word gives each
+// stack's high-water mark. Marks of freed stacks are kept in a histogram
+// for sizing KSTACK_SIZE from real data.
+#define KSTACK_BASE  0x2040000000UL               // right after the vmalloc window
+#define KSTACK_SLOT  (KSTACK_SIZE + PAGE_SIZE)
+#define KSTACK_PAGES (int)(KSTACK_SIZE / PAGE_SIZE)
+
+void      kstack_init(void);
+uint8_t  *kstack_alloc(void);           // lowest stack address; stack top is +KSTACK_SIZE
+void      kstack_free(uint8_t *base);
+int       kstack_fault(uint64_t va);    // 0 when the stack was grown
+uint64_t  kstack_high_water(uint8_t *base);
+void      kstack_dump(void);
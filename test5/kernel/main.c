@@ -1,8 +1,19 @@
 // kernel/main.c for process management and scheduling demo
+#include "kstack.h"
+#include "kvminit.h"
+#include "mem.h"
+#include "pmm.h"
 #include "proc.h"
+#include "riscv.h"
+#include "slab.h"
 #include "trap.h"
+#include "vm.h"
+#include "vmalloc.h"
 #include <stdint.h>
 #include <stdio.h>
+
+#define PHYS_MEM_START 0x80000000UL
+#define PHYS_MEM_END   (PHYS_MEM_START + 128 * 1024 * 1024)
 volatile uint64_t kernel_ticks = 0;  // 全局变量，记录时钟 ticks
 // Simple delay based on timer ticks.
 static void sleep_ticks(uint64_t ticks) {
@@ -41,34 +52,35 @@ static void cpu_intensive_task(void) {
 static int buffer[BUF_SIZE];
 static int head = 0, tail = 0, count = 0;
 static struct spinlock buf_lock;
+static char buf_not_full, buf_not_empty;  // 等待通道，只用地址
 
 static void shared_buffer_init(void) {
-  init_lock(&buf_lock);
+  init_lock(&buf_lock, "buf");
   head = tail = count = 0;
 }
 
 static void buf_put(int v) {
   acquire(&buf_lock);
   while (count == BUF_SIZE) {
-    sleep_on(&buffer, &buf_lock);
+    sleep_on(&buf_not_full, &buf_lock);
   }
   buffer[tail] = v;
   tail = (tail + 1) % BUF_SIZE;
   count++;
   release(&buf_lock);
-  wakeup(&buffer);
+  wakeup_one(&buf_not_empty);  // 一个元素只够一个消费者
 }
 
 static int buf_get(void) {
   acquire(&buf_lock);
   while (count == 0) {
-    sleep_on(&buffer, &buf_lock);
+    sleep_on(&buf_not_empty, &buf_lock);
   }
   int v = buffer[head];
   head = (head + 1) % BUF_SIZE;
   count--;
   release(&buf_lock);
-  wakeup(&buffer);
+  wakeup_one(&buf_not_full);
   return v;
 }
 
@@ -107,6 +119,41 @@ static void test_process_creation(void) {
   }
 }
 
+// 内核栈按需增长：递归约 10KB，只有被碰到的页才会映射
+#define KSTACK_TEST_DEPTH 10
+
+static volatile int kstack_test_sum;
+
+static int kstack_recurse(int depth) {
+  volatile uint8_t frame[1000];
+  frame[0] = (uint8_t)depth;
+  frame[sizeof(frame) - 1] = (uint8_t)depth;
+  if (depth == 0) {
+    return frame[0];
+  }
+  return kstack_recurse(depth - 1) + frame[sizeof(frame) - 1];
+}
+
+static void kstack_task(void) {
+  kstack_test_sum = kstack_recurse(KSTACK_TEST_DEPTH);
+  printf("kstack: pid=%d depth %d high water %luB\n", myproc()->pid, KSTACK_TEST_DEPTH,
+         (unsigned long)kstack_high_water(myproc()->kstack));
+  exit_process(0);
+}
+
+static void test_kstack_growth(void) {
+  printf("Testing kernel stack growth...\n");
+  kstack_test_sum = -1;
+  if (create_process(kstack_task) < 0) {
+    printf("kstack: create_process failed\n");
+    return;
+  }
+  wait_process(NULL);
+  int expect = KSTACK_TEST_DEPTH * (KSTACK_TEST_DEPTH + 1) / 2;
+  printf("kstack: %s\n", kstack_test_sum == expect ? "PASS" : "FAIL");
+  kstack_dump();
+}
+
 static void test_scheduler(void) {
   printf("Testing scheduler...\n");
   for (int i = 0; i < 3; ++i) {
@@ -131,19 +178,678 @@ static void test_synchronization(void) {
   printf("Synchronization test completed\n");
 }
 
+// ---------- Wakeup ----------
+// Latency: a sleeper waits on a flag; this process sets it and calls
+// wakeup_one, and the sleeper measures how long it took to run again, in
+// mtime units (comparable across harts). Herd: WAKE_HERD sleepers wait for
+// tokens posted one at a time. With wakeup every post wakes all of them and
+// all but one find nothing; with wakeup_one such futile wakeups should be
+// rare. Last, the cost of a wakeup on a channel nobody sleeps on.
+#define WAKE_ROUNDS      200
+#define WAKE_HERD        4
+#define WAKE_HERD_TOKENS 20   // per sleeper
+#define WAKE_EMPTY_CALLS 1000
+
+static struct spinlock wake_lock;
+static int wake_flag, wake_waiting;
+static uint64_t wake_t0, wake_total, wake_max;
+static int herd_tokens, herd_futile;
+static char wake_nobody;
+
+static void wake_sleeper(void) {
+  acquire(&wake_lock);
+  for (int i = 0; i < WAKE_ROUNDS; ++i) {
+    while (!wake_flag) {
+      wake_waiting = 1;
+      sleep_on(&wake_flag, &wake_lock);
+    }
+    uint64_t dt = get_time() - wake_t0;
+    wake_total += dt;
+    if (dt > wake_max) {
+      wake_max = dt;
+    }
+    wake_flag = 0;
+    wake_waiting = 0;
+  }
+  release(&wake_lock);
+  exit_process(0);
+}
+
+static void herd_sleeper(void) {
+  acquire(&wake_lock);
+  for (int i = 0; i < WAKE_HERD_TOKENS; ++i) {
+    while (herd_tokens == 0) {
+      sleep_on(&herd_tokens, &wake_lock);
+      if (herd_tokens == 0) {
+        herd_futile++;
+      }
+    }
+    herd_tokens--;
+  }
+  release(&wake_lock);
+  exit_process(0);
+}
+
+// 让出 CPU 直到 *v == want（在 wake_lock 下检查）；返回时持有 wake_lock
+static void wake_wait_for(volatile int *v, int want) {
+  acquire(&wake_lock);
+  while (*v != want) {
+    release(&wake_lock);
+    yield();
+    acquire(&wake_lock);
+  }
+}
+
+static int herd_run(int one) {
+  herd_tokens = 0;
+  herd_futile = 0;
+  int started = 0;
+  for (int i = 0; i < WAKE_HERD; ++i) {
+    started += create_process(herd_sleeper) > 0;
+  }
+  for (int i = 0; i < started * WAKE_HERD_TOKENS; ++i) {
+    wake_wait_for(&herd_tokens, 0);  // 上一个被取走之后再发下一个
+    herd_tokens = 1;
+    release(&wake_lock);
+    if (one) {
+      wakeup_one(&herd_tokens);
+    } else {
+      wakeup(&herd_tokens);
+    }
+  }
+  for (int i = 0; i < started; ++i) {
+    wait_process(NULL);
+  }
+  return herd_futile;
+}
+
+static void test_wakeup(void) {
+  printf("Testing wakeup...\n");
+  init_lock(&wake_lock, "wake");
+  wake_flag = wake_waiting = 0;
+  wake_total = wake_max = 0;
+  if (create_process(wake_sleeper) > 0) {
+    for (int i = 0; i < WAKE_ROUNDS; ++i) {
+      wake_wait_for(&wake_waiting, 1);  // 睡眠者已入等待队列
+      wake_flag = 1;
+      wake_t0 = get_time();
+      release(&wake_lock);
+      wakeup_one(&wake_flag);
+      wake_wait_for(&wake_flag, 0);
+      release(&wake_lock);
+    }
+    wait_process(NULL);
+    printf("wakeup: latency avg %lu max %lu mtime units over %d rounds\n",
+           (unsigned long)(wake_total / WAKE_ROUNDS), (unsigned long)wake_max, WAKE_ROUNDS);
+  }
+
+  int all = herd_run(0);
+  int one = herd_run(1);
+  printf("wakeup: %d sleepers, %d tokens: futile wakeups %d with wakeup, %d with wakeup_one\n",
+         WAKE_HERD, WAKE_HERD * WAKE_HERD_TOKENS, all, one);
+
+  uint64_t t0 = r_cycle();
+  for (int i = 0; i < WAKE_EMPTY_CALLS; ++i) {
+    wakeup(&wake_nobody);
+  }
+  printf("wakeup: no sleepers, %lu cycles per call\n",
+         (unsigned long)((r_cycle() - t0) / WAKE_EMPTY_CALLS));
+}
+
+// ---------- SMP scaling ----------
+// Fixed CPU-bound work per worker: one worker alone, then one per hart. With
+// every hart running scheduler() the second run should take about as long
+// as the first.
+#define SMP_WORK 2000000
+
+static volatile uint64_t smp_harts_seen;  // harts a worker finished on
+
+static void smp_worker(void) {
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < SMP_WORK; ++i) {
+    sum += i;
+  }
+  push_off();
+  __sync_fetch_and_or(&smp_harts_seen, 1UL << cpuid());
+  pop_off();
+  exit_process(0);
+}
+
+static uint64_t smp_run(int n) {
+  uint64_t t0 = get_time();
+  int started = 0;
+  for (int i = 0; i < n; ++i) {
+    started += create_process(smp_worker) > 0;
+  }
+  for (int i = 0; i < started; ++i) {
+    wait_process(NULL);
+  }
+  return get_time() - t0;
+}
+
+static void test_smp_scaling(void) {
+  int n = ncpu_online();
+  printf("Testing SMP scaling on %d harts...\n", n);
+  smp_harts_seen = 0;
+  uint64_t one = smp_run(1);
+  uint64_t all = smp_run(n);
+  uint64_t x10 = all ? (uint64_t)n * one * 10 / all : 0;
+  printf("smp: 1 worker %lu, %d workers %lu mtime units: throughput x%lu.%lu, harts used %#lx\n",
+         (unsigned long)one, n, (unsigned long)all, (unsigned long)(x10 / 10),
+         (unsigned long)(x10 % 10), (unsigned long)smp_harts_seen);
+}
+
+// ---------- Work stealing ----------
+// Workers are created from this hart, so they all start on its run queue
+// and the other harts only get a share by stealing. Then one worker is
+// pinned to the last hart and must not be seen anywhere else.
+#define STEAL_WORKERS_PER_HART 2
+#define AFFINITY_ROUNDS 50
+
+static volatile int affinity_set;
+static volatile uint64_t affinity_seen;
+
+static void affinity_worker(void) {
+  // set_affinity 生效之前可能已在别的 hart 上运行；等父进程设好后 yield 一次，
+  // 重新入队时就会放到允许的 hart 上
+  while (!affinity_set) {
+    yield();
+  }
+  yield();
+  for (int i = 0; i < AFFINITY_ROUNDS; ++i) {
+    push_off();
+    __sync_fetch_and_or(&affinity_seen, 1UL << cpuid());
+    pop_off();
+    yield();
+  }
+  exit_process(0);
+}
+
+static void test_work_stealing(void) {
+  int n = ncpu_online();
+  printf("Testing work stealing on %d harts...\n", n);
+  smp_harts_seen = 0;
+  uint64_t t = smp_run(n * STEAL_WORKERS_PER_HART);
+  printf("steal: %d workers from one hart in %lu mtime units, harts used %#lx\n",
+         n * STEAL_WORKERS_PER_HART, (unsigned long)t, (unsigned long)smp_harts_seen);
+
+  uint64_t want = 1UL << (n - 1);
+  affinity_set = 0;
+  affinity_seen = 0;
+  int pid = create_process(affinity_worker);
+  if (pid > 0) {
+    int ok = set_affinity(pid, want) == 0;
+    affinity_set = 1;
+    wait_process(NULL);
+    printf("affinity: pinned to %#lx, ran on %#lx: %s\n", (unsigned long)want,
+           (unsigned long)affinity_seen, ok && affinity_seen == want ? "PASS" : "FAIL");
+  }
+  sched_dump();
+}
+
+// ---------- Locks ----------
+// Every online hart increments one shared counter LOCK_ITERS times, first
+// under a spinlock, then under a ticket lock. A lost update means broken
+// mutual exclusion; the time is what the lock costs under full contention.
+#define LOCK_ITERS 20000
+
+static struct spinlock test_spin;
+static struct ticketlock test_ticket;
+static int lock_test_ticket;  // 0: test_spin, 1: test_ticket
+static volatile uint64_t lock_test_count;
+
+static void lock_worker(void) {
+  for (int i = 0; i < LOCK_ITERS; ++i) {
+    if (lock_test_ticket) {
+      ticket_acquire(&test_ticket);
+      lock_test_count++;
+      ticket_release(&test_ticket);
+    } else {
+      acquire(&test_spin);
+      lock_test_count++;
+      release(&test_spin);
+    }
+  }
+  exit_process(0);
+}
+
+static void lock_run(const char *name, int ticket, int n) {
+  lock_test_ticket = ticket;
+  lock_test_count = 0;
+  uint64_t t0 = get_time();
+  int started = 0;
+  for (int i = 0; i < n; ++i) {
+    started += create_process(lock_worker) > 0;
+  }
+  for (int i = 0; i < started; ++i) {
+    wait_process(NULL);
+  }
+  uint64_t t = get_time() - t0;
+  uint64_t expect = (uint64_t)started * LOCK_ITERS;
+  printf("locks: %s, %d workers: count %lu/%lu %s, %lu mtime units\n", name, started,
+         (unsigned long)lock_test_count, (unsigned long)expect,
+         lock_test_count == expect ? "PASS" : "FAIL", (unsigned long)t);
+}
+
+static void test_locks(void) {
+  int n = ncpu_online();
+  printf("Testing locks on %d harts...\n", n);
+  init_lock(&test_spin, "test_spin");
+  init_ticketlock(&test_ticket, "test_ticket");
+  lock_run("spinlock", 0, n);
+  lock_run("ticket lock", 1, n);
+}
+
+// ---------- Run queue ----------
+// Pick-next cost on a private run queue filled with dummy procs, against
+// the old policy of walking the process list for the first RUNNABLE entry
+// (worst case: only the last one is runnable). The bitmap pick should stay
+// flat as the count grows.
+#define RQ_BENCH_MAX 1024
+#define RQ_BENCH_OPS 1024
+
+static struct proc rq_bench_procs[RQ_BENCH_MAX];
+
+static int runq_order_ok(void) {
+  struct runqueue rq;
+  runq_init(&rq, -1);
+  // 优先级 5,3,5,0,3：期望出队顺序 3(0) 1(3) 4(3) 0(5) 2(5)
+  static const int prio[] = {5, 3, 5, 0, 3};
+  static const int expect[] = {3, 1, 4, 0, 2};
+  for (int i = 0; i < 5; i++) {
+    rq_bench_procs[i].priority = prio[i];
+    runq_push(&rq, &rq_bench_procs[i]);
+  }
+  for (int i = 0; i < 5; i++) {
+    if (runq_pop(&rq) != &rq_bench_procs[expect[i]]) {
+      return 0;
+    }
+  }
+  return runq_pop(&rq) == NULL && rq.bitmap == 0 && rq.nr == 0;
+}
+
+static void test_runqueue(void) {
+  printf("Testing run queue...\n");
+  printf("runq order: %s\n", runq_order_ok() ? "PASS" : "FAIL");
+
+  for (int n = 1; n <= RQ_BENCH_MAX; n *= 4) {
+    struct proc *list = NULL;
+    for (int i = n - 1; i >= 0; i--) {
+      struct proc *p = &rq_bench_procs[i];
+      p->state = (i == n - 1) ? RUNNABLE : SLEEPING;
+      p->next = list;
+      list = p;
+    }
+    volatile struct proc *found = NULL;
+    uint64_t t0 = r_cycle();
+    for (int op = 0; op < RQ_BENCH_OPS; op++) {
+      for (struct proc *p = list; p; p = p->next) {
+        if (p->state == RUNNABLE) {
+          found = p;
+          break;
+        }
+      }
+    }
+    uint64_t scan = (r_cycle() - t0) / RQ_BENCH_OPS;
+
+    // 所有进程都可运行，分散在各优先级上；每次 pick 后像 yield 一样放回队尾
+    struct runqueue rq;
+    runq_init(&rq, -1);
+    for (int i = 0; i < n; i++) {
+      rq_bench_procs[i].priority = i % NPRIO;
+      runq_push(&rq, &rq_bench_procs[i]);
+    }
+    t0 = r_cycle();
+    for (int op = 0; op < RQ_BENCH_OPS; op++) {
+      struct proc *p = runq_pop(&rq);
+      found = p;
+      runq_push(&rq, p);
+    }
+    uint64_t pick = (r_cycle() - t0) / RQ_BENCH_OPS;
+    (void)found;
+    printf("runq: %d procs: list scan %lu cycles, bitmap pick+requeue %lu cycles\n", n,
+           (unsigned long)scan, (unsigned long)pick);
+  }
+}
+
+// ---------- Copy-on-write demo ----------
+#define COW_TEST_VA UVM_BASE
+
+static void test_cow(void) {
+  printf("Testing copy-on-write...\n");
+  struct mm *parent = mm_create();
+  uint64_t *page = alloc_page();
+  if (!parent || !page || map_page(parent->pagetable, COW_TEST_VA, (uint64_t)page,
+                                   PTE_R | PTE_W | PTE_U) != 0) {
+    printf("cow: setup failed\n");
+    return;
+  }
+  page[0] = 0x1111;
+
+  uint64_t t0 = r_cycle();
+  struct mm *child = mm_copy(parent);
+  uint64_t t1 = r_cycle();
+  if (!child) {
+    printf("cow: mm_copy failed\n");
+    mm_free(parent);
+    return;
+  }
+  printf("mm_copy took %lu cycles, shared page refcount=%d\n",
+         (unsigned long)(t1 - t0), page_ref_count(page));
+
+  volatile uint64_t *va = (volatile uint64_t *)COW_TEST_VA;
+  w_sstatus(r_sstatus() | SSTATUS_SUM);
+  mm_switch(child);
+  *va = 0x2222;              // 第一次写：复制私有页
+  uint64_t child_val = *va;
+  mm_switch(parent);
+  uint64_t parent_val = *va; // 父进程仍看到原值
+  *va = 0x3333;              // 只剩一个引用：不复制，直接恢复 W
+  mm_switch(child);
+  uint64_t child_again = *va; // 切回时靠 ASID 区分，不需要刷新 TLB
+  mm_switch(NULL);
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+
+  int ok = child_val == 0x2222 && parent_val == 0x1111 && page[0] == 0x3333 &&
+           child_again == 0x2222 && page_ref_count(page) == 1;
+  printf("cow: child=%#lx parent=%#lx asids=%d/%d -> %s\n", (unsigned long)child_val,
+         (unsigned long)parent_val, child->asid, parent->asid, ok ? "OK" : "ERROR");
+  mm_free(child);
+  mm_free(parent);
+  vm_dump_stats();
+}
+
+// ---------- Demand paging demo ----------
+#define LAZY_TEST_VA   UVM_BASE
+#define LAZY_TEST_SIZE (64UL * 1024 * 1024)
+#define LAZY_TOUCH     16
+
+static void test_demand_paging(void) {
+  printf("Testing demand paging...\n");
+  struct mm *mm = mm_create();
+  if (!mm) {
+    printf("lazy: mm_create failed\n");
+    return;
+  }
+  uint64_t free0 = pmm_free_pages();
+  uint64_t t0 = r_cycle();
+  int r = mm_mmap(mm, LAZY_TEST_VA, LAZY_TEST_SIZE, PTE_R | PTE_W, 0);
+  uint64_t t1 = r_cycle();
+  printf("lazy: reserved %lu MB in %lu cycles, %lu pages used\n",
+         (unsigned long)(LAZY_TEST_SIZE >> 20), (unsigned long)(t1 - t0),
+         (unsigned long)(free0 - pmm_free_pages()));
+
+  // 预填充区域：mmap 时一次性分配，之后访问不再缺页
+  uint64_t pre_va = LAZY_TEST_VA + LAZY_TEST_SIZE;
+  t0 = r_cycle();
+  r |= mm_mmap(mm, pre_va, LAZY_TOUCH * 4096, PTE_R | PTE_W, VMA_PREFAULT);
+  t1 = r_cycle();
+  printf("lazy: prefaulted %d pages in %lu cycles\n", LAZY_TOUCH,
+         (unsigned long)(t1 - t0));
+
+  w_sstatus(r_sstatus() | SSTATUS_SUM);
+  mm_switch(mm);
+  int ok = (r == 0);
+  uint64_t stride = LAZY_TEST_SIZE / LAZY_TOUCH;
+  for (int i = 0; i < LAZY_TOUCH; ++i) {
+    volatile uint64_t *p = (volatile uint64_t *)(LAZY_TEST_VA + i * stride);
+    if (i & 1) {
+      ok &= (*p == 0);        // 读缺页：得到清零页
+    } else {
+      *p = (uint64_t)i + 1;   // 写缺页
+      ok &= (*p == (uint64_t)i + 1);
+    }
+    ((volatile uint64_t *)pre_va)[i * 512] = (uint64_t)i;  // 预填充页：不缺页
+  }
+  mm_switch(NULL);
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+
+  printf("lazy: touched %d pages, resident now %lu pages -> %s\n", LAZY_TOUCH,
+         (unsigned long)(free0 - pmm_free_pages()), ok ? "OK" : "ERROR");
+  mm_free(mm);
+  vm_dump_stats();
+}
+
+// 内核子表共享：新 mm 只占一页根表；之后新增/删除的内核根表项
+// 必须出现在已存在的地址空间里
+#define KSHARE_TEST_VA (UVM_TOP + 2 * LEVEL_SIZE(PT_ROOT_LEVEL))  // 开机时为空的根表项
+
+static void test_kernel_share(void) {
+  printf("Testing shared kernel page tables...\n");
+  struct mm *mm = mm_create();
+  uint64_t *page = alloc_page();
+  if (!mm || !page) {
+    printf("kshare: allocation failed\n");
+    mm_free(mm);
+    if (page) {
+      free_page(page);
+    }
+    return;
+  }
+  struct pt_usage ku, u;
+  pagetable_usage(kernel_pagetable, &ku);
+  pagetable_usage(mm->pagetable, &u);
+  // 遍历会经过共享的内核子表，只有根表是新的
+  int ok = u.tables == ku.tables;
+
+  page[0] = 0x5a5a5a5a;
+  ok &= kvm_map(KSHARE_TEST_VA, (uint64_t)page, PAGE_SIZE, PTE_R | PTE_W) == 0;
+  ok &= kvm_map(UVM_BASE, (uint64_t)page, PAGE_SIZE, PTE_R) < 0;
+  mm_switch(mm);
+  ok &= *(volatile uint64_t *)KSHARE_TEST_VA == 0x5a5a5a5a;
+  mm_switch(NULL);
+  ok &= kvm_unmap(KSHARE_TEST_VA, LEVEL_SIZE(PT_ROOT_LEVEL)) == 0;
+  ok &= !(mm->pagetable[VPN_MASK(KSHARE_TEST_VA, PT_ROOT_LEVEL)] & PTE_V);
+
+  mm_free(mm);
+  free_page(page);
+  printf("kshare: tables visible from new mm=%d, %s\n", u.tables, ok ? "PASS" : "FAIL");
+}
+
+// vmalloc：大块缓冲逐页映射，前后是不映射的保护页
+#define VMALLOC_TEST_SIZE (1UL << 20)
+
+static int vmalloc_guarded(void *p, uint64_t size) {
+  uint64_t va = (uint64_t)p;
+  pte_t *lo = walk_lookup(kernel_pagetable, va - PAGE_SIZE);
+  pte_t *hi = walk_lookup(kernel_pagetable, va + size);
+  return !(lo && (*lo & PTE_V)) && !(hi && (*hi & PTE_V));
+}
+
+static void test_vmalloc(void) {
+  printf("Testing vmalloc...\n");
+  uint64_t free0 = pmm_free_pages();
+  uint64_t *a = vmalloc(VMALLOC_TEST_SIZE);
+  uint64_t *b = vmalloc(3 * PAGE_SIZE);
+  int ok = a && b && vmalloc_guarded(a, VMALLOC_TEST_SIZE) && vmalloc_guarded(b, 3 * PAGE_SIZE);
+  if (a) {
+    uint64_t words = VMALLOC_TEST_SIZE / sizeof(uint64_t);
+    for (uint64_t i = 0; i < words; i += PAGE_SIZE / sizeof(uint64_t)) {
+      ok &= a[i] == 0;
+      a[i] = i;
+    }
+    for (uint64_t i = 0; i < words; i += PAGE_SIZE / sizeof(uint64_t)) {
+      ok &= a[i] == i;
+    }
+  }
+  vmalloc_dump();
+  vfree(a);
+  vfree(b);
+  // 页表页可能留在页表页池里，只比较数据页是否全部归还
+  ok &= (int64_t)(free0 - pmm_free_pages()) < 16;
+  printf("vmalloc: %s\n", ok ? "PASS" : "FAIL");
+}
+
+// 短命地址空间反复创建/销毁：页表页应当来自页表页池，不经过 PMM
+#define MM_CHURN_ROUNDS 64
+
+static void test_mm_churn(void) {
+  printf("Testing address-space churn...\n");
+  uint64_t allocs0 = pmm_event_count(PMM_EV_ALLOC);
+  uint64_t t0 = r_cycle();
+  for (int i = 0; i < MM_CHURN_ROUNDS; ++i) {
+    mm_free(mm_create());
+  }
+  uint64_t t1 = r_cycle();
+  printf("mm churn: %d create/destroy in %lu cycles, %lu PMM allocations\n",
+         MM_CHURN_ROUNDS, (unsigned long)(t1 - t0),
+         (unsigned long)(pmm_event_count(PMM_EV_ALLOC) - allocs0));
+  pt_pool_dump();
+}
+
+// mem*/strlen: correctness at odd alignments and lengths, then bandwidth.
+// The byte rows are plain loops through volatile pointers so the compiler
+// cannot turn them back into library calls.
+#define MEM_BENCH_ORDER 4                                // 16 pages = 64KB
+#define MEM_BENCH_SIZE  (PAGE_SIZE << MEM_BENCH_ORDER)
+#define MEM_BENCH_ROUNDS 16
+
+static void print_mem_rate(const char *name, uint64_t cycles) {
+  uint64_t bytes = (uint64_t)MEM_BENCH_SIZE * MEM_BENCH_ROUNDS;
+  uint64_t bpc100 = cycles ? bytes * 100 / cycles : 0;   // bytes/cycle x100
+  printf("  %s: %lu cycles, %lu.%lu%lu bytes/cycle\n", name, (unsigned long)cycles,
+         (unsigned long)(bpc100 / 100), (unsigned long)(bpc100 / 10 % 10),
+         (unsigned long)(bpc100 % 10));
+}
+
+static int mem_check(unsigned char *a, unsigned char *b) {
+  static const size_t lens[] = {0, 1, 7, 8, 9, 31, 64, 255, 4096 + 13};
+  int ok = 1;
+  for (size_t li = 0; li < sizeof(lens) / sizeof(lens[0]); li++) {
+    size_t n = lens[li];
+    for (int da = 0; da < 8; da++) {
+      for (int sa = 0; sa < 8; sa++) {
+        for (size_t i = 0; i < n + 16; i++) {
+          a[i] = (unsigned char)(i * 7 + 1);
+          b[i] = 0xEE;
+        }
+        memcpy(b + da, a + sa, n);
+        for (size_t i = 0; i < n; i++) ok &= b[da + i] == a[sa + i];
+        ok &= b[da + n] == 0xEE && (da == 0 || b[da - 1] == 0xEE);
+        ok &= memcmp(b + da, a + sa, n) == 0;
+        if (n) {
+          b[da + n - 1] ^= 1;
+          ok &= (memcmp(b + da, a + sa, n) != 0);
+        }
+        memset(b + da, sa, n);
+        for (size_t i = 0; i < n; i++) ok &= b[da + i] == sa;
+        ok &= b[da + n] == 0xEE;
+        // 重叠复制：向后（dst 在 src 之后）与向前
+        memmove(a + sa + da, a + sa, n);
+        for (size_t i = 0; i < n; i++) ok &= a[sa + da + i] == (unsigned char)((sa + i) * 7 + 1);
+      }
+    }
+  }
+  for (size_t n = 0; n < 40; n++) {
+    for (int al = 0; al < 8; al++) {
+      for (size_t i = 0; i < n; i++) a[al + i] = 'x';
+      a[al + n] = 0;
+      ok &= strlen((char *)a + al) == n;
+    }
+  }
+  return ok;
+}
+
+static void test_mem_bandwidth(void) {
+  printf("Testing mem/string library (%s)...\n", mem_impl_name());
+  unsigned char *a = alloc_pages_flags(MEM_BENCH_ORDER, 0);
+  unsigned char *b = alloc_pages_flags(MEM_BENCH_ORDER, 0);
+  if (!a || !b) {
+    printf("mem: cannot allocate buffers\n");
+    if (a) free_pages_order(a, MEM_BENCH_ORDER);
+    if (b) free_pages_order(b, MEM_BENCH_ORDER);
+    return;
+  }
+  printf("mem: %s\n", mem_check(a, b) ? "PASS" : "FAIL");
+
+  printf("mem: %d KB x %d rounds\n", MEM_BENCH_SIZE / 1024, MEM_BENCH_ROUNDS);
+  uint64_t t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) {
+    volatile unsigned char *p = b;
+    for (size_t i = 0; i < MEM_BENCH_SIZE; i++) p[i] = (unsigned char)r;
+  }
+  print_mem_rate("byte set", r_cycle() - t0);
+
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) memset(b, r, MEM_BENCH_SIZE);
+  print_mem_rate("memset", r_cycle() - t0);
+
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) {
+    volatile unsigned char *d = b;
+    const volatile unsigned char *s = a;
+    for (size_t i = 0; i < MEM_BENCH_SIZE; i++) d[i] = s[i];
+  }
+  print_mem_rate("byte copy", r_cycle() - t0);
+
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) memcpy(b, a, MEM_BENCH_SIZE);
+  print_mem_rate("memcpy", r_cycle() - t0);
+
+  // src 与 dst 错开 3 字节：字循环走移位拼接路径
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) memcpy(b, a + 3, MEM_BENCH_SIZE - 8);
+  print_mem_rate("memcpy +3", r_cycle() - t0);
+
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) memmove(b + 8, b, MEM_BENCH_SIZE - 8);
+  print_mem_rate("memmove back", r_cycle() - t0);
+
+  memcpy(b, a, MEM_BENCH_SIZE);
+  volatile int sink = 0;
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) sink += memcmp(b, a, MEM_BENCH_SIZE);
+  print_mem_rate("memcmp", r_cycle() - t0);
+
+  memset(a, 'x', MEM_BENCH_SIZE - 1);
+  a[MEM_BENCH_SIZE - 1] = 0;
+  t0 = r_cycle();
+  for (int r = 0; r < MEM_BENCH_ROUNDS; r++) sink += (int)strlen((char *)a);
+  print_mem_rate("strlen", r_cycle() - t0);
+  (void)sink;
+
+  free_pages_order(a, MEM_BENCH_ORDER);
+  free_pages_order(b, MEM_BENCH_ORDER);
+}
+
 void kmain(void) {
   printf("Kernel start.\n");
+  extern char _end[];
+  pmm_init((uint64_t)_end, PHYS_MEM_END);
+  pt_pool_init();
+  kvminit();
+  kvminithart();
+  kvm_hart_online();
+  vm_init();
+  vmalloc_init();
+  kstack_init();
   proc_init();
   scheduler_init();
   init_bootproc();
+  start_other_harts();
 
   test_process_creation();
   test_scheduler();
+  test_smp_scaling();
+  test_work_stealing();
+  test_locks();
   test_synchronization();
+  test_wakeup();
+  test_runqueue();
+  test_kstack_growth();
+  test_cow();
+  test_demand_paging();
+  test_kernel_share();
+  test_vmalloc();
+  test_mm_churn();
+  test_mem_bandwidth();
   debug_proc_table();
+  sched_dump();
+  lock_dump();
+  kmem_cache_dump();
+  pmm_dump();
 
   printf("All tests done. Entering scheduler loop.\n");
-  // keep running scheduler
-  yield();
-  scheduler();
+  // 引导进程退出，本 hart 回到 scheduler_entry 开始的调度循环
+  exit_process(0);
 }
\ No newline at end of file
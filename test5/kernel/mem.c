@@ -1,11 +1,283 @@
 // kernel/mem.c
+// 内核的 mem*/str* 函数。编译器也会为结构体赋值等生成对它们的调用。
+//
+// 实现在编译期由 -march 选择（Makefile 中的 MEM_MARCH，只作用于本文件）：
+// - 带 v 扩展（定义了 __riscv_vector）：RVV 1.0 的 e8/m8 循环，每条指令处理 VLEN 个字节
+// - 否则：按 64 位字对齐的循环，只在开头和结尾按字节处理
+//
+// 内核其他文件不带 v 编译，陷入和进程切换都不保存向量寄存器。因此每段向量代码
+// 都在关中断下运行，最多处理 VEC_CHUNK 字节后开一次中断；每条 asm 语句内部自己
+// 执行 vsetvli，不依赖上一条语句留下的向量状态，所以在两段之间被抢占没有问题。
+//
+// 关中断挡不住缺页（内核栈增长、写时复制、按需分配）：处理完后 vle8/vse8 从
+// vstart 重新执行，用的是返回时 v8-v23、vl、vtype 里的值。所以缺页处理路径上
+// 不能执行任何向量指令：kerneltrap 的缺页处理能到达的代码都不调用 mem*/str*，
+// 整个内核用 -fno-tree-loop-distribute-patterns 编译，GCC 不会把 copy_page 之类
+// 的循环换成 memcpy 调用（见 Makefile）。
 #include <stddef.h>  // 用于 size_t 类型
+#include <stdint.h>
+#include "mem.h"
+#include "riscv.h"
+
+// 按字访问调用者的任意类型对象，声明 may_alias 以免违反严格别名规则
+typedef uint64_t __attribute__((may_alias)) word_t;
+
+#define WSIZE    sizeof(word_t)
+#define WMASK    (WSIZE - 1)
+#define ONES     0x0101010101010101ULL
+#define HIGHS    0x8080808080808080ULL
+
+static inline int word_aligned(const void *p) {
+  return ((uintptr_t)p & WMASK) == 0;
+}
+
+// 某个字节为 0 的字：减法借位会把该字节的最高位置 1
+static inline uint64_t has_zero(uint64_t x) {
+  return (x - ONES) & ~x & HIGHS;
+}
+
+#ifdef __riscv_vector
+
+#define VEC_CHUNK 4096  // 关中断的最长一段
+
+const char *mem_impl_name(void) { return "rvv"; }
 
 // 将 s 指向的内存块的前 n 个字节设置为值 c（无符号字符）
 void *memset(void *s, int c, size_t n) {
-    unsigned char *ptr = (unsigned char *)s;  // 转换为字节指针
-    for (size_t i = 0; i < n; i++) {
-        ptr[i] = (unsigned char)c;  // 填充每个字节
+  unsigned char *p = s;
+  while (n) {
+    size_t chunk = n < VEC_CHUNK ? n : VEC_CHUNK;
+    n -= chunk;
+    uint64_t intr = intr_save();
+    while (chunk) {
+      size_t vl;
+      asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n\t"
+                   "vmv.v.x v8, %2\n\t"
+                   "vse8.v v8, (%3)"
+                   : "=&r"(vl) : "r"(chunk), "r"(c), "r"(p) : "v8", "v9", "v10", "v11",
+                     "v12", "v13", "v14", "v15", "memory");
+      p += vl;
+      chunk -= vl;
+    }
+    intr_restore(intr);
+  }
+  return s;
+}
+
+// 逐段“整段读入再写出”：正向复制时 dst 在 src 之前或不重叠都安全
+static void vec_copy_fwd(unsigned char *d, const unsigned char *s, size_t n) {
+  while (n) {
+    size_t chunk = n < VEC_CHUNK ? n : VEC_CHUNK;
+    n -= chunk;
+    uint64_t intr = intr_save();
+    while (chunk) {
+      size_t vl;
+      asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n\t"
+                   "vle8.v v8, (%2)\n\t"
+                   "vse8.v v8, (%3)"
+                   : "=&r"(vl) : "r"(chunk), "r"(s), "r"(d) : "v8", "v9", "v10", "v11",
+                     "v12", "v13", "v14", "v15", "memory");
+      s += vl;
+      d += vl;
+      chunk -= vl;
+    }
+    intr_restore(intr);
+  }
+}
+
+// 从尾部向前逐段复制，用于 dst 落在 src 之后的重叠区间
+static void vec_copy_bwd(unsigned char *d, const unsigned char *s, size_t n) {
+  while (n) {
+    size_t chunk = n < VEC_CHUNK ? n : VEC_CHUNK;
+    uint64_t intr = intr_save();
+    while (chunk) {
+      size_t vl;
+      asm volatile("vsetvli %0, %1, e8, m8, ta, ma" : "=r"(vl) : "r"(chunk));
+      n -= vl;
+      chunk -= vl;
+      asm volatile("vsetvli zero, %0, e8, m8, ta, ma\n\t"
+                   "vle8.v v8, (%1)\n\t"
+                   "vse8.v v8, (%2)"
+                   :: "r"(vl), "r"(s + n), "r"(d + n) : "v8", "v9", "v10", "v11",
+                     "v12", "v13", "v14", "v15", "memory");
+    }
+    intr_restore(intr);
+  }
+}
+
+void *memcpy(void *dst, const void *src, size_t n) {
+  vec_copy_fwd(dst, src, n);
+  return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+  if (d <= s || d >= s + n) vec_copy_fwd(d, s, n);
+  else vec_copy_bwd(d, s, n);
+  return dst;
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+  const unsigned char *p = a, *q = b;
+  while (n) {
+    size_t chunk = n < VEC_CHUNK ? n : VEC_CHUNK;
+    n -= chunk;
+    uint64_t intr = intr_save();
+    while (chunk) {
+      size_t vl;
+      long idx;
+      asm volatile("vsetvli %0, %2, e8, m8, ta, ma\n\t"
+                   "vle8.v v8, (%3)\n\t"
+                   "vle8.v v16, (%4)\n\t"
+                   "vmsne.vv v0, v8, v16\n\t"
+                   "vfirst.m %1, v0"
+                   : "=&r"(vl), "=r"(idx) : "r"(chunk), "r"(p), "r"(q)
+                   : "v0", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15",
+                     "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "memory");
+      if (idx >= 0) {
+        intr_restore(intr);
+        return p[idx] - q[idx];
+      }
+      p += vl;
+      q += vl;
+      chunk -= vl;
+    }
+    intr_restore(intr);
+  }
+  return 0;
+}
+
+// vle8ff.v 遇到无法访问的地址时只截短 vl，不会在字符串结尾之后触发缺页
+size_t strlen(const char *str) {
+  const char *p = str;
+  uint64_t intr = intr_save();
+  for (;;) {
+    size_t vl;
+    long idx;
+    asm volatile("vsetvli zero, %2, e8, m8, ta, ma\n\t"
+                 "vle8ff.v v8, (%3)\n\t"
+                 "csrr %0, vl\n\t"
+                 "vmseq.vi v0, v8, 0\n\t"
+                 "vfirst.m %1, v0"
+                 : "=&r"(vl), "=r"(idx) : "r"((size_t)-1), "r"(p)
+                 : "v0", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "memory");
+    if (idx >= 0) {
+      intr_restore(intr);
+      return (size_t)(p - str) + (size_t)idx;
     }
-    return s;  // 返回原始指针（符合标准库行为）
-}
\ No newline at end of file
+    p += vl;
+  }
+}
+
+#else  // !__riscv_vector
+
+const char *mem_impl_name(void) { return "word"; }
+
+// 将 s 指向的内存块的前 n 个字节设置为值 c（无符号字符）
+void *memset(void *s, int c, size_t n) {
+  unsigned char *p = s;
+  for (; n && !word_aligned(p); n--) *p++ = (unsigned char)c;
+  uint64_t v = ONES * (unsigned char)c;
+  word_t *w = (word_t *)p;
+  for (; n >= 4 * WSIZE; n -= 4 * WSIZE, w += 4) {
+    w[0] = v; w[1] = v; w[2] = v; w[3] = v;
+  }
+  for (; n >= WSIZE; n -= WSIZE) *w++ = v;
+  p = (unsigned char *)w;
+  while (n--) *p++ = (unsigned char)c;
+  return s;
+}
+
+// 正向复制，dst 在 src 之前或两者不重叠时安全。
+// dst 对齐后若 src 仍未对齐，按对齐字读取 src，再用移位拼出目标字；
+// 每次读取的字都至少含一个需要的字节，不会越过源区间所在的字。
+static void word_copy_fwd(unsigned char *d, const unsigned char *s, size_t n) {
+  for (; n && !word_aligned(d); n--) *d++ = *s++;
+  word_t *dw = (word_t *)d;
+  unsigned shift = ((uintptr_t)s & WMASK) * 8;
+  if (shift == 0) {
+    const word_t *sw = (const word_t *)s;
+    for (; n >= 4 * WSIZE; n -= 4 * WSIZE, dw += 4, sw += 4) {
+      uint64_t a = sw[0], b = sw[1], c = sw[2], e = sw[3];
+      dw[0] = a; dw[1] = b; dw[2] = c; dw[3] = e;
+    }
+    for (; n >= WSIZE; n -= WSIZE) *dw++ = *sw++;
+    s = (const unsigned char *)sw;
+  } else if (n >= WSIZE) {
+    const word_t *sw = (const word_t *)((uintptr_t)s & ~WMASK);
+    uint64_t lo = *sw++;
+    for (; n >= WSIZE; n -= WSIZE) {
+      uint64_t hi = *sw++;
+      *dw++ = (lo >> shift) | (hi << (64 - shift));
+      lo = hi;
+      s += WSIZE;
+    }
+  }
+  d = (unsigned char *)dw;
+  while (n--) *d++ = *s++;
+}
+
+// 从尾部向前复制，用于 dst 落在 src 之后的重叠区间；两者同余对齐时按字复制
+static void word_copy_bwd(unsigned char *d, const unsigned char *s, size_t n) {
+  d += n;
+  s += n;
+  if ((((uintptr_t)d ^ (uintptr_t)s) & WMASK) == 0) {
+    for (; n && !word_aligned(d); n--) *--d = *--s;
+    word_t *dw = (word_t *)d;
+    const word_t *sw = (const word_t *)s;
+    for (; n >= WSIZE; n -= WSIZE) *--dw = *--sw;
+    d = (unsigned char *)dw;
+    s = (const unsigned char *)sw;
+  }
+  while (n--) *--d = *--s;
+}
+
+void *memcpy(void *dst, const void *src, size_t n) {
+  word_copy_fwd(dst, src, n);
+  return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+  if (d <= s || d >= s + n) word_copy_fwd(d, s, n);
+  else word_copy_bwd(d, s, n);
+  return dst;
+}
+
+// 同余对齐时按字比较，找到不同的字后再逐字节定位
+int memcmp(const void *a, const void *b, size_t n) {
+  const unsigned char *p = a, *q = b;
+  if ((((uintptr_t)p ^ (uintptr_t)q) & WMASK) == 0) {
+    for (; n && !word_aligned(p); n--, p++, q++) {
+      if (*p != *q) return *p - *q;
+    }
+    const word_t *pw = (const word_t *)p, *qw = (const word_t *)q;
+    for (; n >= WSIZE && *pw == *qw; n -= WSIZE) {
+      pw++;
+      qw++;
+    }
+    p = (const unsigned char *)pw;
+    q = (const unsigned char *)qw;
+  }
+  for (; n; n--, p++, q++) {
+    if (*p != *q) return *p - *q;
+  }
+  return 0;
+}
+
+// 对齐后每次检查一个字；读取不会越过结尾 '\0' 所在的字
+size_t strlen(const char *str) {
+  const char *p = str;
+  for (; !word_aligned(p); p++) {
+    if (!*p) return (size_t)(p - str);
+  }
+  const word_t *w = (const word_t *)p;
+  while (!has_zero(*w)) w++;
+  for (p = (const char *)w; *p; p++) {
+  }
+  return (size_t)(p - str);
+}
+
+#endif  // __riscv_vector
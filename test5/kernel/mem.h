@@ -0,0 +1,16 @@
+// kernel/mem.h
+#pragma once
+
+#include <stddef.h>
+
+// Freestanding replacements for the C library routines. The compiler also
+// emits calls to these for struct copies and large initialisers. mem.c is
+// built with its own -march (MEM_MARCH in the Makefile): RVV 1.0 kernels
+// when the v extension is enabled, aligned 64-bit word loops otherwise.
+void  *memset(void *s, int c, size_t n);
+void  *memcpy(void *dst, const void *src, size_t n);
+void  *memmove(void *dst, const void *src, size_t n);
+int    memcmp(const void *a, const void *b, size_t n);
+size_t strlen(const char *s);
+
+const char *mem_impl_name(void);   // "rvv" or "word"
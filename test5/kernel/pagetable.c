@@ -0,0 +1,675 @@
+/**
+ * kernel/pagetable.c - 页表管理系统
+ * 
+ * 实现原理：
+ * 1. Sv39页表结构：3级页表（Level 2, 1, 0）；以 -DPT_SV48 构建时为
+ *    Sv48 的 4 级页表（Level 3..0），层数是编译期常量 PT_LEVELS
+ * 2. 虚拟地址解析：39位地址 = 9位VPN[2] + 9位VPN[1] + 9位VPN[0] + 12位偏移
+ *    （Sv48 在最高处再加 9 位 VPN[3]，共 48 位）
+ * 3. 页表遍历：从根页表开始，逐级查找/创建中间表；循环次数是常量，
+ *    编译器按所选模式完全展开，Sv39 构建与手写三级遍历相同
+ * 
+ * 核心函数：
+ * - walk_create: 遍历并创建中间页表（用于建立映射）
+ * - walk_lookup: 遍历查找页表项（不创建，用于查找）
+ * - map_page: 建立虚拟地址到物理地址的映射
+ * - map_page_level: 在指定层级建立叶子映射（2MB 大页 / 1GB 巨页）
+ * - 页表页池：页表页来自专用的预清零空闲链表，不与普通分配竞争；
+ *   整棵子树拆除时收集成一批，一次归还
+ * - map_range/unmap_range: 范围遍历器，每个页表页只进入一次，
+ *   在同一张表里连续填写/清除 PTE，结束后统一刷新 TLB
+ */
+
+#include "pagetable.h"
+#include "pmm.h"
+#include "printf.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define NPTE (int)(PAGE_SIZE / sizeof(pte_t)) /* 每页表页包含512个PTE（9位索引） */
+
+/* 逐级遍历的循环按最大层数完全展开 */
+#define WALK_UNROLL _Pragma("GCC unroll 4")
+
+/**
+ * pte_to_table - 从PTE中提取页表页的物理地址
+ * 
+ * PTE格式：PPN[53:10] | flags[9:0]
+ * 将物理页号(PPN)左移12位得到物理地址
+ */
+static inline pagetable_t pte_to_table(pte_t pte) {
+    uint64_t ppn = (pte >> PPN_SHIFT);  // 提取物理页号
+    uint64_t addr = (ppn << 12);        // 转换为物理地址
+    return (pagetable_t)addr;
+}
+
+/**
+ * make_pte_for_table - 创建指向子页表的PTE
+ * 
+ * 用于在父页表中创建指向子页表页的PTE
+ * 标志位：PTE_V（有效位）
+ */
+static inline pte_t make_pte_for_table(void* child_page) {
+    uint64_t ppn = ((uint64_t)child_page) >> 12;  // 物理页号
+    return (ppn << PPN_SHIFT) | PTE_V;             // 仅设置有效位
+}
+
+/**
+ * make_leaf_pte - 创建叶子PTE（指向物理页）
+ * 
+ * 用于建立最终的虚拟地址到物理地址映射
+ * 标志位：PTE_V（有效位）+ perm（权限位：R/W/X/U等）
+ */
+static inline pte_t make_leaf_pte(uint64_t pa, int perm) {
+    uint64_t ppn = pa >> 12;                       // 物理页号
+    return (ppn << PPN_SHIFT) | (uint64_t)(perm) | PTE_V;
+}
+
+/*
+ * 页表页池
+ *
+ * 池中的页除第 0 项（链表指针）外全部为 0。页表页被拆除时，
+ * 遍历过程已经把每个有效 PTE 清零，因此归还时不需要再清零整页，
+ * 取出时只需清掉第 0 项。
+ * 池空时从 PMM 批量补充 PT_POOL_BATCH 页；超过 PT_POOL_MAX 的部分还给 PMM。
+ */
+#define PT_POOL_BATCH 16
+#define PT_POOL_MAX   128
+
+static void *pt_pool_head;
+static int pt_pool_count;
+static struct spinlock pt_pool_lock;  /* spinlock 持有期间关中断，缺页路径也会取它 */
+
+static struct {
+    uint64_t allocs;     /* 从池中取出 */
+    uint64_t refills;    /* 从 PMM 批量补充 */
+    uint64_t frees;      /* 归还到池中的页 */
+    uint64_t batches;    /* 批量归还次数 */
+    uint64_t overflow;   /* 池满后还给 PMM 的页 */
+} pt_pool_stats;
+
+/* pt_pool_init - 初始化页表页池的锁，在第一次分配页表页之前调用 */
+void pt_pool_init(void) {
+    init_lock(&pt_pool_lock, "pt_pool");
+}
+
+/* 把 n 页的链 [head..tail] 挂入池中，超出上限的部分返回给调用者 */
+static void *pt_pool_push(void *head, void *tail, int n, int *left) {
+    acquire(&pt_pool_lock);
+    int room = PT_POOL_MAX - pt_pool_count;
+    void *rest = NULL;
+    if (n <= room) {
+        *(void**)tail = pt_pool_head;
+        pt_pool_head = head;
+        pt_pool_count += n;
+        *left = 0;
+    } else {
+        /* 放得下的前 room 页入池，其余交回 */
+        void *last = head;
+        for (int i = 1; i < room; i++) last = *(void**)last;
+        if (room > 0) {
+            rest = *(void**)last;
+            *(void**)last = pt_pool_head;
+            pt_pool_head = head;
+            pt_pool_count += room;
+        } else {
+            rest = head;
+        }
+        *left = n - (room > 0 ? room : 0);
+    }
+    release(&pt_pool_lock);
+    return rest;
+}
+
+/**
+ * alloc_pagetable_page - 分配一个清零的页表页
+ * 
+ * 页表页必须清零，确保所有PTE初始为0（无效）。
+ * 优先从页表页池取；池空时一次从 PMM 补充一批
+ */
+void* alloc_pagetable_page(void) {
+    acquire(&pt_pool_lock);
+    void *p = pt_pool_head;
+    if (p) {
+        pt_pool_head = *(void**)p;
+        pt_pool_count--;
+        pt_pool_stats.allocs++;
+    }
+    release(&pt_pool_lock);
+    if (p) {
+        *(void**)p = NULL;
+        return p;
+    }
+
+    /* 池空：alloc_page 返回清零页（通常直接取自预清零池），第一页直接使用，其余入池 */
+    p = alloc_page();
+    if (!p) return NULL;
+    struct pt_batch b = {0};
+    for (int i = 1; i < PT_POOL_BATCH; i++) {
+        void *q = alloc_page();
+        if (!q) break;
+        pt_batch_add(&b, q);
+    }
+    pt_pool_stats.refills++;
+    pt_pool_stats.allocs++;
+    if (b.n) {
+        int left;
+        void *rest = pt_pool_push(b.head, b.tail, b.n, &left);
+        while (rest) {                  /* 只有并发补充时池才可能已满 */
+            void *next = *(void**)rest;
+            *(void**)rest = NULL;
+            free_page(rest);
+            rest = next;
+        }
+    }
+    return p;
+}
+
+/* free_pagetable_batch - 把一批已清空的页表页一次性还给池 */
+void free_pagetable_batch(struct pt_batch *b) {
+    if (!b->n) return;
+    int left;
+    void *rest = pt_pool_push(b->head, b->tail, b->n, &left);
+    pt_pool_stats.frees += b->n - left;
+    pt_pool_stats.batches++;
+    while (rest) {
+        void *next = *(void**)rest;
+        *(void**)rest = NULL;
+        free_page(rest);
+        rest = next;
+        pt_pool_stats.overflow++;
+    }
+    b->head = b->tail = NULL;
+    b->n = 0;
+}
+
+/* pt_batch_add - 把一个已清空的页表页加入待归还批次 */
+void pt_batch_add(struct pt_batch *b, void *page) {
+    *(void**)page = b->head;
+    if (!b->head) b->tail = page;
+    b->head = page;
+    b->n++;
+}
+
+/* free_pagetable_page - 归还单个已清空的页表页 */
+void free_pagetable_page(void *page) {
+    struct pt_batch b = {0};
+    pt_batch_add(&b, page);
+    free_pagetable_batch(&b);
+}
+
+void pt_pool_dump(void) {
+    printf("pt pool: cached=%d allocs=%d refills=%d frees=%d batches=%d overflow=%d\n",
+           pt_pool_count, (int)pt_pool_stats.allocs, (int)pt_pool_stats.refills,
+           (int)pt_pool_stats.frees, (int)pt_pool_stats.batches,
+           (int)pt_pool_stats.overflow);
+}
+
+/**
+ * create_pagetable - 创建新的根页表
+ * 
+ * 返回：分配好的页表页指针
+ * 
+ * 页表本身就是一页内存，包含512个64位PTE项
+ */
+pagetable_t create_pagetable(void) {
+    void *p = alloc_pagetable_page();
+    return (pagetable_t)p;
+}
+
+/**
+ * walk_create - 页表遍历并创建（用于建立映射）
+ * 
+ * 功能：从根页表遍历到Level 0，创建所有需要的中间页表
+ * 
+ * 工作流程（以Sv39为例，VA=0x40000000）：
+ * 1. Level 2 (VPN[2])：检查根页表项，不存在则创建
+ * 2. Level 1 (VPN[1])：进入中间页表，检查并创建
+ * 3. Level 0 (VPN[0])：返回指向最终PTE的指针
+ * 
+ * 安全机制：
+ * - 检查冲突：如果遇到已存在的叶子映射，返回NULL
+ * - 自动分配：中间页表不存在时自动创建
+ */
+pte_t* walk_create(pagetable_t pt, uint64_t va) {
+    return walk_create_level(pt, va, 0);
+}
+
+/**
+ * walk_create_level - 遍历并创建到指定层级，返回该层的PTE槽位
+ * 
+ * level = 0 等同 walk_create；level = 1/2 用于放置 2MB/1GB 叶子
+ * 路径上遇到更高层的叶子映射时返回NULL
+ */
+pte_t* walk_create_level(pagetable_t pt, uint64_t va, int level_stop) {
+    if (!pt || level_stop < 0 || level_stop >= PT_LEVELS) return NULL;
+    pagetable_t table = pt;
+    
+    /* 从根（Level PT_ROOT_LEVEL）到level_stop+1，逐级遍历 */
+    WALK_UNROLL
+    for (int level = PT_ROOT_LEVEL; level > level_stop; level--) {
+        /* 提取当前级别的页表索引（9位）*/
+        uint64_t idx = VPN_MASK(va, level);
+        pte_t pte = table[idx];
+        
+        if (pte & PTE_V) {
+            /* PTE有效，检查是否为叶子映射（冲突检测）*/
+            if (pte & (PTE_R|PTE_W|PTE_X)) {
+                /* 已经是叶子映射，不能继续创建子表 */
+                return NULL;
+            }
+            /* 非叶子：进入下一级页表 */
+            table = pte_to_table(pte);
+        } else {
+            /* PTE无效，需要创建子页表页 */
+            void *child = alloc_pagetable_page();
+            if (!child) return NULL;
+            /* 在父页表中创建指向子页表的PTE */
+            table[idx] = make_pte_for_table(child);
+            /* 切换到子页表继续遍历 */
+            table = (pagetable_t)child;
+        }
+    }
+    /* 返回目标层的PTE指针，用于设置最终的映射 */
+    return &table[VPN_MASK(va, level_stop)];
+}
+
+/**
+ * walk_lookup - 页表查找（不创建）
+ * 
+ * 功能：查找虚拟地址对应的PTE
+ * 
+ * 与walk_create的区别：
+ * - walk_create: 创建不存在的中间表
+ * - walk_lookup: 只查找，不创建
+ * 
+ * 返回值：
+ * - 成功：返回PTE指针（可能在任意层级）
+ * - 失败：返回NULL
+ */
+pte_t* walk_lookup(pagetable_t pt, uint64_t va) {
+    if (!pt) return NULL;
+    pagetable_t table = pt;
+    
+    WALK_UNROLL
+    for (int level = PT_ROOT_LEVEL; level > 0; level--) {
+        uint64_t idx = VPN_MASK(va, level);
+        pte_t pte = table[idx];
+        
+        if (!(pte & PTE_V)) return NULL;  // 无效PTE，映射不存在
+        
+        if (pte & (PTE_R|PTE_W|PTE_X)) {
+            /* 找到叶子映射（在更高层级）*/
+            return &table[idx];
+        }
+        /* 继续下一级 */
+        table = pte_to_table(pte);
+    }
+    /* 到达Level 0，返回最终PTE */
+    return &table[VPN_MASK(va, 0)];
+}
+
+/**
+ * walk_lookup_level - 查找遍历停下的位置（不创建）
+ * 
+ * 返回遍历停下处的PTE指针，并通过 level 返回其层级：
+ * - 叶子映射（任意层级）
+ * - 无效PTE：该层及以下都还没有映射，可以在 <= level 的层级放置叶子
+ * - Level 0 的PTE（可能无效）
+ */
+pte_t* walk_lookup_level(pagetable_t pt, uint64_t va, int *level) {
+    if (!pt) return NULL;
+    pagetable_t table = pt;
+    int l = PT_ROOT_LEVEL;
+    WALK_UNROLL
+    for (; l > 0; l--) {
+        pte_t pte = table[VPN_MASK(va, l)];
+        if (!(pte & PTE_V) || (pte & (PTE_R|PTE_W|PTE_X))) break;
+        table = pte_to_table(pte);
+    }
+    if (level) *level = l;
+    return &table[VPN_MASK(va, l)];
+}
+
+/**
+ * map_page - 建立虚拟地址到物理地址的页映射
+ * 
+ * 参数：
+ * - pt: 页表指针
+ * - va: 虚拟地址（必须页对齐）
+ * - pa: 物理地址（必须页对齐）
+ * - perm: 权限位（PTE_R | PTE_W | PTE_X等）
+ * 
+ * 返回值：成功返回0，失败返回-1
+ * 
+ * 工作流程：
+ * 1. 检查地址对齐
+ * 2. 遍历页表找到目标PTE（自动创建中间表）
+ * 3. 检查是否已映射（避免重复映射）
+ * 4. 设置PTE的物理页号和权限
+ */
+int map_page(pagetable_t pt, uint64_t va, uint64_t pa, int perm) {
+    return map_page_level(pt, va, pa, perm, 0);
+}
+
+/**
+ * map_page_level - 在指定层级建立叶子映射
+ * 
+ * level 0/1/2 分别对应 4KB 页、2MB 大页、1GB 巨页（Sv48 还有 level 3）；
+ * va 与 pa 都必须按该层的叶子大小对齐
+ */
+int map_page_level(pagetable_t pt, uint64_t va, uint64_t pa, int perm, int level) {
+    if (level < 0 || level >= PT_LEVELS) return -1;
+
+    /* 1. 地址对齐检查：必须是该层叶子大小的边界 */
+    uint64_t align = LEVEL_SIZE(level) - 1;
+    if ((va & align) || (pa & align)) {
+        printf("map_page: addresses must be aligned to the level-%d leaf size\n", level);
+        return -1;
+    }
+    
+    /* 2. 遍历页表找到目标PTE（自动创建中间页表）*/
+    pte_t *pte = walk_create_level(pt, va, level);
+    if (!pte) {
+        printf("map_page: walk_create failed for va %p\n", (void*)va);
+        return -1;
+    }
+    
+    /* 3. 检查是否已映射（防止重复映射；大页槽位上不能已有子页表）*/
+    if (*pte & PTE_V) {
+        printf("map_page: VA %p already mapped\n", (void*)va);
+        return -1;
+    }
+    
+    /* 4. 创建叶子PTE，设置映射 */
+    *pte = make_leaf_pte(pa, perm);
+    return 0;
+}
+
+/*
+ * 范围遍历器
+ *
+ * 从根表开始递归：在每一层只处理落在 [va, end) 内的连续槽位，
+ * 进入子表时把子范围整体交给下一层，因此每个页表页只被访问一次，
+ * 而不是像逐页 walk 那样每页从根走一遍。
+ */
+enum range_op { RANGE_MAP, RANGE_UNMAP };
+
+struct range_walk {
+    enum range_op op;
+    uint64_t end;        /* 范围末尾（不含） */
+    uint64_t pa_off;     /* map：pa = va + pa_off（按 2^64 取模） */
+    int perm;            /* map：叶子权限 */
+    int free_leaves;     /* unmap：同时释放叶子指向的物理块 */
+    struct pt_deferred *defer; /* unmap：非空时清空的页表页和要释放的叶子都挂到这里 */
+};
+
+/* TLB 刷新批处理：超过该页数直接整体刷新 */
+#define FLUSH_ALL_PAGES 64
+
+static int walk_range(pagetable_t table, int level, uint64_t va, struct range_walk *w);
+
+/* split_leaf - 把 level 层的大页叶子拆成下一层的 512 个等价叶子 */
+static int split_leaf(pte_t *pte, int level) {
+    pagetable_t child = (pagetable_t)alloc_pagetable_page();
+    if (!child) return -1;
+    uint64_t pa = PTE2PA(*pte);
+    uint64_t flags = PTE_FLAGS(*pte);
+    for (int i = 0; i < NPTE; i++) {
+        child[i] = PA2PTE(pa + (uint64_t)i * LEVEL_SIZE(level - 1)) | flags;
+    }
+    *pte = make_pte_for_table(child);
+    return 0;
+}
+
+static int map_slot(pte_t *pte, int level, uint64_t va, int whole, struct range_walk *w) {
+    uint64_t pa = va + w->pa_off;
+    if (*pte & PTE_V) {
+        if (*pte & (PTE_R|PTE_W|PTE_X)) return 0;  /* 已映射，跳过 */
+        return walk_range(pte_to_table(*pte), level - 1, va, w);
+    }
+    /* 空槽：整段覆盖且 pa 对齐时直接放叶子（level 0 总是满足） */
+    if (level == 0 || (whole && !(pa & (LEVEL_SIZE(level) - 1)))) {
+        *pte = make_leaf_pte(pa, w->perm);
+        return 0;
+    }
+    void *child = alloc_pagetable_page();
+    if (!child) return -1;
+    *pte = make_pte_for_table(child);
+    return walk_range((pagetable_t)child, level - 1, va, w);
+}
+
+/*
+ * free_leaf - 释放叶子映射的物理块。1GB（及以上）大页超过 buddy 的 MAX_ORDER，
+ * 按 2^MAX_ORDER 页一块逐块归还；不归 PMM 管理的块跳过
+ */
+static void free_leaf(uint64_t pa, int level) {
+    int order = level * 9;
+    uint64_t blocks = 1;
+    if (order > MAX_ORDER) {
+        blocks = 1UL << (order - MAX_ORDER);
+        order = MAX_ORDER;
+    }
+    for (uint64_t i = 0; i < blocks; i++) {
+        uint64_t b = pa + i * ((uint64_t)PAGE_SIZE << order);
+        if (pmm_managed(b)) free_pages_order((void*)b, order);
+    }
+}
+
+/* 延迟释放的叶子块：链接字和层级写在块的开头 */
+struct dead_leaf {
+    struct dead_leaf *next;
+    int level;
+};
+
+/*
+ * defer_leaf - 把叶子块挂到延迟链表。不归 PMM 管理的块写不得，还有其他引用的
+ * 块释放后也不会被重新分配，这两种照常处理
+ */
+static void defer_leaf(struct pt_deferred *d, uint64_t pa, int level) {
+    if (!pmm_managed(pa) || page_ref_count((void*)pa) != 1) {
+        free_leaf(pa, level);
+        return;
+    }
+    struct dead_leaf *l = (struct dead_leaf*)pa;
+    l->next = d->leaves;
+    l->level = level;
+    d->leaves = l;
+}
+
+static int unmap_slot(pte_t *pte, int level, uint64_t va, int whole, struct range_walk *w) {
+    if (!(*pte & PTE_V)) return 0;
+    if (*pte & (PTE_R|PTE_W|PTE_X)) {
+        if (whole || level == 0) {
+            uint64_t pa = PTE2PA(*pte);
+            *pte = 0;
+            if (w->free_leaves) {
+                if (w->defer) defer_leaf(w->defer, pa, level);
+                else free_leaf(pa, level);
+            }
+            return 0;
+        }
+        /* 只覆盖大页的一部分：先拆分，释放模式下无法只还一部分 */
+        if (w->free_leaves) {
+            printf("unmap_range: cannot free part of a level-%d leaf at %p\n",
+                   level, (void*)va);
+            return -1;
+        }
+        if (split_leaf(pte, level) < 0) return -1;
+    }
+    pagetable_t child = pte_to_table(*pte);
+    if (walk_range(child, level - 1, va, w) < 0) return -1;
+    if (whole) {
+        /* 子表覆盖的范围全部解除，子表已经为空 */
+        *pte = 0;
+        if (w->defer) pt_batch_add(&w->defer->tables, (void*)child);
+        else free_pagetable_page((void*)child);
+    }
+    return 0;
+}
+
+static int walk_range(pagetable_t table, int level, uint64_t va, struct range_walk *w) {
+    uint64_t span = LEVEL_SIZE(level);
+    for (int idx = VPN_MASK(va, level); idx < NPTE && va < w->end; idx++) {
+        uint64_t next = (va & ~(span - 1)) + span;
+        uint64_t chunk_end = next < w->end ? next : w->end;
+        int whole = !(va & (span - 1)) && chunk_end == next;
+        int r = (w->op == RANGE_MAP)
+                ? map_slot(&table[idx], level, va, whole, w)
+                : unmap_slot(&table[idx], level, va, whole, w);
+        if (r < 0) return -1;
+        va = chunk_end;
+    }
+    return 0;
+}
+
+/*
+ * flush_tlb_range - 范围修改结束后统一刷新
+ *
+ * 页数少时逐页 sfence.vma va，否则一次整体刷新，避免逐页刷新的开销
+ */
+static void flush_tlb_range(uint64_t va, uint64_t end) {
+    if ((end - va) / PAGE_SIZE > FLUSH_ALL_PAGES) {
+        sfence_vma_all();
+        return;
+    }
+    for (; va < end; va += PAGE_SIZE) sfence_vma_va(va);
+}
+
+/**
+ * map_range - 建立 [va, va+size) -> [pa, pa+size) 的映射
+ *
+ * 地址与长度必须页对齐。已存在的叶子保持不变（跳过）；
+ * va、pa 与剩余长度都对齐到 2MB/1GB 时放置大页叶子。
+ * 无效 -> 有效的修改不需要刷新 TLB
+ *
+ * 返回：成功 0，页表页分配失败 -1（已建立的部分映射保留）
+ */
+int map_range(pagetable_t pt, uint64_t va, uint64_t pa, uint64_t size, int perm) {
+    if (!pt || ((va | pa | size) & (PAGE_SIZE - 1))) return -1;
+    if (size == 0) return 0;
+    struct range_walk w = {
+        .op = RANGE_MAP, .end = va + size, .pa_off = pa - va, .perm = perm,
+    };
+    return walk_range(pt, PT_ROOT_LEVEL, va, &w);
+}
+
+/**
+ * unmap_range - 解除 [va, va+size) 内的全部映射
+ *
+ * 参数：free_leaves - 非 0 时把叶子指向的 PMM 物理块一并释放（放弃一个引用）
+ *
+ * 部分覆盖的大页会被拆分；完全清空的页表页被释放。
+ * 全部修改完成后统一刷新一次 TLB
+ */
+int unmap_range(pagetable_t pt, uint64_t va, uint64_t size, int free_leaves) {
+    return unmap_range_deferred(pt, va, size, free_leaves, NULL);
+}
+
+/**
+ * unmap_range_deferred - 同 unmap_range，但清空的页表页和叶子指向的块不立即归还
+ *
+ * 参数：defer - 收集要释放的页（为 NULL 时立即释放），之后用 pt_deferred_free 归还
+ *
+ * 页表页还可能被别处引用时使用（例如共享的内核子表仍挂在其他根表上）：
+ * 调用者先撤掉所有引用，再用 free_pagetable_batch 归还
+ */
+int unmap_range_deferred(pagetable_t pt, uint64_t va, uint64_t size, int free_leaves,
+                         struct pt_deferred *defer) {
+    if (!pt || ((va | size) & (PAGE_SIZE - 1))) return -1;
+    if (size == 0) return 0;
+    struct range_walk w = {
+        .op = RANGE_UNMAP, .end = va + size, .free_leaves = free_leaves, .defer = defer,
+    };
+    int r = walk_range(pt, PT_ROOT_LEVEL, va, &w);
+    flush_tlb_range(va, va + size);
+    return r;
+}
+
+/* pt_deferred_free - 归还 unmap_range_deferred 收集的页表页和叶子块 */
+void pt_deferred_free(struct pt_deferred *d) {
+    free_pagetable_batch(&d->tables);
+    while (d->leaves) {
+        struct dead_leaf *l = d->leaves;
+        d->leaves = l->next;
+        free_leaf((uint64_t)l, l->level);
+    }
+}
+
+/* destroy_level: recursively destroy page table pages (only page-table pages).
+   We DO NOT free physical pages that were mapped as leaves here.
+   Emptied table pages are collected in `b` and returned in one batch. */
+static void destroy_level(pagetable_t table, int level, struct pt_batch *b) {
+    if (!table) return;
+    for (int i = 0; i < NPTE; i++) {
+        pte_t pte = table[i];
+        if (!(pte & PTE_V)) continue;
+        /* If it's a leaf (has R/W/X), skip (do not free mapped physical memory) */
+        if ( (pte & (PTE_R|PTE_W|PTE_X)) ) {
+            table[i] = 0;
+            continue;
+        }
+        /* Non-leaf: child page table */
+        pagetable_t child = pte_to_table(pte);
+        /* clear entry first to avoid re-entrance issues */
+        table[i] = 0;
+        /* recurse into child; the now-empty child joins the batch */
+        destroy_level(child, level - 1, b);
+        pt_batch_add(b, (void*)child);
+    }
+}
+
+/* destroy entire pagetable rooted at pt (including freeing root page) */
+void destroy_pagetable(pagetable_t pt) {
+    if (!pt) return;
+    struct pt_batch b = {0};
+    destroy_level(pt, PT_ROOT_LEVEL, &b);
+    pt_batch_add(&b, (void*)pt);
+    free_pagetable_batch(&b);
+}
+
+/* usage_level: count table pages and leaves below one table */
+static void usage_level(pagetable_t table, int level, struct pt_usage *u) {
+    u->tables++;
+    for (int i = 0; i < NPTE; i++) {
+        pte_t pte = table[i];
+        if (!(pte & PTE_V)) continue;
+        if (level == 0 || (pte & (PTE_R|PTE_W|PTE_X))) {
+            u->leaves[level]++;
+        } else {
+            usage_level(pte_to_table(pte), level - 1, u);
+        }
+    }
+}
+
+void pagetable_usage(pagetable_t pt, struct pt_usage *u) {
+    u->tables = 0;
+    for (int l = 0; l < PT_LEVELS; l++) u->leaves[l] = 0;
+    if (pt) usage_level(pt, PT_ROOT_LEVEL, u);
+}
+
+/* Dump helpers: compute va_base at this level and recurse */
+static void dump_level(pagetable_t table, int level, uint64_t va_base) {
+    if (!table) return;
+    for (int i = 0; i < NPTE; i++) {
+        pte_t pte = table[i];
+        if (!(pte & PTE_V)) continue;
+        uint64_t va = va_base | ((uint64_t)i << VPN_SHIFT(level));
+        if (pte & (PTE_R|PTE_W|PTE_X)) {
+            uint64_t pa = (pte >> PPN_SHIFT) << 12;
+            int perm = pte & (PTE_R|PTE_W|PTE_X);
+            printf("MAP: va=%p -> pa=%p perm=0x%x\n", (void*)va, (void*)pa, perm);
+        } else {
+            /* non-leaf: recurse to child */
+            pagetable_t child = pte_to_table(pte);
+            dump_level(child, level - 1, va);
+        }
+    }
+}
+
+void dump_pagetable(pagetable_t pt) {
+    printf("Dump pagetable:\n");
+    dump_level(pt, PT_ROOT_LEVEL, 0UL);
+}
@@ -0,0 +1,64 @@
+#ifndef _PMM_H_
+#define _PMM_H_
+
+#include <stdint.h>
+
+//#define PAGE_SIZE 4096
+
+/* buddy 分配器最大阶：2^MAX_ORDER 页 = 4MB */
+#define MAX_ORDER 10
+
+void pmm_init(uint64_t start, uint64_t end);
+void* alloc_page(void);
+void free_page(void* page);
+void* alloc_pages(int n);
+void free_pages(void* page, int n);
+
+/* 按阶分配/释放：返回 2^order 页物理连续、按块大小对齐的内存 */
+#define PMM_ZERO 0x1   /* 需要清零的页 */
+void* alloc_pages_flags(int order, int flags);
+void* alloc_pages_order(int order);   /* = alloc_pages_flags(order, PMM_ZERO) */
+void free_pages_order(void* page, int order);
+void* alloc_page_nozero(void);
+
+/*
+ * 引用计数：分配得到的块引用数为 1，释放函数每次放弃一个引用，
+ * 引用数归零时才真正归还。共享物理页（写时复制）时用 page_ref_inc 增加引用
+ */
+void page_ref_inc(void* page);
+int page_ref_count(void* page);
+int pmm_managed(uint64_t pa);
+
+/*
+ * 页清零：启动时用 zicboz_probe（riscv.h，M 模式）探测 Zicboz，
+ * 把 cache block 大小交给 pmm_set_cbo_block；之后所有清零都用 cbo.zero，
+ * 不支持时按 64 位字写入
+ */
+void pmm_set_cbo_block(int size);
+int pmm_cbo_block(void);
+void clear_pages(void* page, uint64_t n);
+
+/* 空闲时补充本 hart 的预清零页，返回本次清零的页数 */
+int pmm_zero_refill(int budget);
+
+/* 统计接口 */
+uint64_t pmm_free_pages(void);
+int pmm_largest_free_order(void);
+void pmm_dump(void);
+
+/*
+ * 分配事件：每个 hart 各自计数，热路径上不输出任何内容；
+ * 需要审计时打开事件日志（环形缓冲），事后用 pmm_log_dump 输出
+ */
+enum pmm_event {
+    PMM_EV_ALLOC,       /* 分配成功 */
+    PMM_EV_ALLOC_FAIL,  /* 分配失败（内存不足） */
+    PMM_EV_FREE,        /* 释放成功 */
+    PMM_EV_BAD_FREE,    /* 非法释放（越界/未对齐/重复释放） */
+    PMM_EV_NR
+};
+uint64_t pmm_event_count(int ev);   /* 所有 hart 的计数之和 */
+void pmm_log_enable(int on);
+void pmm_log_dump(void);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdarg.h>
 #include <stddef.h>
+#include "riscv.h"
 
 extern void console_putc(char c);
 extern void console_puts(const char *s);
@@ -95,10 +96,19 @@ static void console_out(char c, void *ctx) {
     (void)ctx;
     console_putc(c);
 }
+// 多个 hart 同时输出时按整条消息串行化，避免字符交错
+static volatile int print_lock_word;
+
 int printf(const char *fmt, ...) {
+    uint64_t s = intr_save();
+    while (__sync_lock_test_and_set(&print_lock_word, 1)) {
+        // spin
+    }
     va_list ap; va_start(ap, fmt);
     vformat(fmt, ap, console_out, NULL);
     va_end(ap);
+    __sync_lock_release(&print_lock_word);
+    intr_restore(s);
     return 0;
 }
 
@@ -0,0 +1,7 @@
+#ifndef _PRINTF_H_
+#define _PRINTF_H_
+
+int printf(const char *fmt, ...);
+int sprintf(char *buf, const char *fmt, ...);
+
+#endif
@@ -1,5 +1,9 @@
 #include "proc.h"
+#include "kstack.h"
+#include "pmm.h"
 #include "riscv.h"
+#include "slab.h"
+#include "vm.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -7,30 +11,68 @@
 extern void swtch(struct context *old, struct context *new);
 // 在 proc.c 顶部添加
 extern volatile uint64_t kernel_ticks;
-struct proc proc_table[NPROC];
-static uint8_t kstacks[NPROC][KSTACK_SIZE];
-static struct cpu cpus = {0};
+struct proc *proc_list;
+// proc_list_lock 保护 proc_list、nproc_live、nextpid 与 parent 指针，
+// 也是 wait_process 睡眠用的锁（避免丢失子进程退出的唤醒）。
+// 加锁顺序：proc_list_lock -> 等待队列桶锁 -> p->lock -> 各 hart 的运行队列锁
+static struct spinlock proc_list_lock;
+static int nproc_live;
+
+// 等待通道：chan 地址散列到 NWAITQ 个桶，桶内是在该桶任一 chan 上睡眠的进程
+// （经 p->wq_next 链接，按睡眠先后排列）。wakeup 只需查看一个桶。
+// 加锁顺序：调用者传给 sleep_on 的锁 -> 桶锁 -> p->lock
+#define WAITQ_SHIFT 6
+#define NWAITQ      (1 << WAITQ_SHIFT)
+
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+};
+static struct waitq waitqs[NWAITQ];
+
+static inline struct waitq *waitq_of(void *chan) {
+  return &waitqs[((uint64_t)chan * 0x9E3779B97F4A7C15ULL) >> (64 - WAITQ_SHIFT)];
+}
+static struct kmem_cache *proc_cache;
+static struct cpu cpus[NCPU];
 static int nextpid = 1;
 static uint8_t scheduler_stack[4096];
 
-void init_lock(struct spinlock *lk) { lk->locked = 0; }
-void acquire(struct spinlock *lk) { (void)lk; }
-void release(struct spinlock *lk) { (void)lk; }
+// mycpu: tp holds the hart id. Call with interrupts off, or the process may
+// move to another hart before the result is used.
+struct cpu *mycpu(void) { return &cpus[cpuid()]; }
 
-struct cpu *mycpu(void) { return &cpus; }
-struct proc *myproc(void) { return mycpu()->proc; }
+struct proc *myproc(void) {
+  push_off();
+  struct proc *p = mycpu()->proc;
+  pop_off();
+  return p;
+}
 
+// 调用者持有 proc_list_lock
 static int allocpid(void) { return nextpid++; }
 
 // 关键修改：提前声明 alloc_process 函数
 static struct proc *alloc_process(void);
 
+static void proc_ctor(void *obj) {
+  struct proc *p = (struct proc *)obj;
+  init_lock(&p->lock, "proc");
+  p->state = UNUSED;
+}
+
 void proc_init(void) {
-  for (int i = 0; i < NPROC; ++i) {
-    init_lock(&proc_table[i].lock);
-    proc_table[i].state = UNUSED;
-    proc_table[i].kstack = &kstacks[i][0];
-    proc_table[i].parent = NULL;
+  proc_list = NULL;
+  nproc_live = 0;
+  init_lock(&proc_list_lock, "proc_list");
+  for (int i = 0; i < NWAITQ; i++) {
+    init_lock(&waitqs[i].lock, "waitq");
+    waitqs[i].head = NULL;
+  }
+  sched_init();
+  proc_cache = kmem_cache_create("proc", sizeof(struct proc), 0, proc_ctor);
+  if (!proc_cache) {
+    panic("proc_init: cannot create proc cache");
   }
 }
 
@@ -44,36 +86,93 @@ struct proc *init_bootproc(void) {
   p->parent_pid = 0;
   p->parent = NULL;
   snprintf(p->name, sizeof(p->name), "boot");
-  release(&p->lock);
+  push_off();
   mycpu()->proc = p;
+  pop_off();
+  release(&p->lock);
   return p;
 }
 
-// alloc_process 函数定义（保持不变）
+// alloc_process: take a struct proc from the slab cache and a lazily grown
+// kernel stack, then link it into proc_list.
 static struct proc *alloc_process(void) {
-  for (int i = 0; i < NPROC; ++i) {
-    struct proc *p = &proc_table[i];
-    acquire(&p->lock);
-    if (p->state == UNUSED) {
-      p->state = RUNNABLE;
-      p->pid = allocpid();
-      p->killed = 0;
-      p->chan = NULL;
-      p->entry = NULL;
-      p->xstate = 0;
-      p->parent_pid = 0;
-      p->parent = NULL;
-      memset(&p->context, 0, sizeof(p->context));
-      release(&p->lock);
-      return p;
+  // 先占名额，分配失败再退回，避免持锁调用 slab/kstack
+  acquire(&proc_list_lock);
+  if (nproc_live >= NPROC) {
+    release(&proc_list_lock);
+    return NULL;
+  }
+  nproc_live++;
+  release(&proc_list_lock);
+
+  struct proc *p = kmem_cache_alloc(proc_cache);
+  if (p) {
+    p->kstack = kstack_alloc();
+    if (!p->kstack) {
+      kmem_cache_free(proc_cache, p);
+      p = NULL;
     }
-    release(&p->lock);
   }
-  return NULL;
+  if (!p) {
+    acquire(&proc_list_lock);
+    nproc_live--;
+    release(&proc_list_lock);
+    return NULL;
+  }
+  acquire(&proc_list_lock);
+  acquire(&p->lock);
+  p->state = UNUSED;  // create_process 装好上下文后才置为 RUNNABLE 并入队
+  p->pid = allocpid();
+  p->killed = 0;
+  p->chan = NULL;
+  p->wq_next = NULL;
+  p->entry = NULL;
+  p->xstate = 0;
+  p->parent_pid = 0;
+  p->parent = NULL;
+  p->mm = NULL;
+  p->priority = PRIO_DEFAULT;
+  p->affinity = AFFINITY_ALL;
+  p->cpu = -1;
+  p->last_cpu = -1;
+  p->rq_next = NULL;
+  memset(&p->context, 0, sizeof(p->context));
+  p->next = proc_list;
+  proc_list = p;
+  release(&p->lock);
+  release(&proc_list_lock);
+  return p;
+}
+
+// free_process: unlink a reaped process and give its memory back. The
+// object goes back to the cache in constructed state (lock initialised,
+// state UNUSED). Called with proc_list_lock held; returns the kernel
+// stack, which the caller frees after dropping the lock because
+// kstack_free waits for every hart to flush its TLB. The process still
+// counts against NPROC until its stack slot is free.
+static uint8_t *free_process(struct proc *p) {
+  for (struct proc **pp = &proc_list; *pp;) {
+    if (*pp == p) {
+      *pp = p->next;
+      continue;
+    }
+    if ((*pp)->parent == p) {
+      (*pp)->parent = NULL;
+    }
+    pp = &(*pp)->next;
+  }
+  uint8_t *kstack = p->kstack;
+  p->kstack = NULL;
+  p->next = NULL;
+  p->state = UNUSED;
+  kmem_cache_free(proc_cache, p);
+  return kstack;
 }
 
 // 以下代码保持不变
 static void process_trampoline(void) {
+  // scheduler() 持有 p->lock 切换过来，先释放（同时恢复中断）
+  release(&myproc()->lock);
   struct proc *p = myproc();
   if (p && p->entry) {
     p->entry();
@@ -87,50 +186,107 @@ int create_process(void (*entry)(void)) {
   if (!p) {
     return -1;
   }
-  p->entry = entry;
+  acquire(&proc_list_lock);
   p->parent_pid = parent ? parent->pid : 0;
   p->parent = parent;
+  release(&proc_list_lock);
+  p->entry = entry;
   snprintf(p->name, sizeof(p->name), "proc%d", p->pid);
 
   // set up stack/context
   uint64_t sp = (uint64_t)(p->kstack + KSTACK_SIZE);
   p->context.sp = sp;
   p->context.ra = (uint64_t)process_trampoline;
-  return p->pid;
+
+  int pid = p->pid;
+  acquire(&p->lock);
+  p->state = RUNNABLE;
+  sched_enqueue(p, cpuid());  // 新进程留在创建它的 hart 上，空闲 hart 会来偷
+  release(&p->lock);
+  return pid;
 }
 
+// scheduler_entry: hart 0's scheduler context starts here when the boot
+// process first switches away. Finish that switch the way scheduler() does
+// after swtch returns.
+static void scheduler_entry(void) {
+  struct cpu *c = mycpu();
+  struct proc *p = c->proc;
+  c->proc = NULL;
+  release(&p->lock);
+  scheduler();
+}
+
+// scheduler_init: hart 0 only. The boot process runs on the boot stack, so
+// the first yield needs a scheduler context to switch to; the other harts
+// call scheduler() directly and fill their context on the first swtch.
 void scheduler_init(void) {
+  push_off();
   struct cpu *c = mycpu();
+  pop_off();
   memset(&c->context, 0, sizeof(c->context));
   c->context.sp = (uint64_t)(scheduler_stack + sizeof(scheduler_stack));
-  c->context.ra = (uint64_t)scheduler;
+  c->context.ra = (uint64_t)scheduler_entry;
 }
 
+// scheduler: runs on every hart. Take the next process off this hart's run
+// queue (or steal one) and switch to it with p->lock held; the process releases the lock
+// (process_trampoline, or the release after sched() returns). A process
+// popped while another hart is still switching away from it waits here on
+// p->lock until that switch is complete.
 void scheduler(void) {
-  struct cpu *c = mycpu();
+  struct cpu *c = mycpu();  // 调度器不会迁移，c 一直有效
   for (;;) {
     intr_on();
-    for (int i = 0; i < NPROC; ++i) {
-      struct proc *p = &proc_table[i];
-      acquire(&p->lock);
-      if (p->state == RUNNABLE) {
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-        c->proc = NULL;
+    struct proc *p = sched_pick();
+    if (!p) {
+      // Idle: answer kernel TLB shootdowns promptly, and pre-zero pages so
+      // page allocations skip the memset later.
+      push_off();
+      kvm_tlb_ack();
+      pop_off();
+      pmm_zero_refill(8);
+      continue;
+    }
+    acquire(&p->lock);
+    if (p->state == RUNNABLE) {
+      p->state = RUNNING;
+      if (current_mm() != p->mm) {
+        mm_switch(p->mm);
+      }
+      c->proc = p;
+      swtch(&c->context, &p->context);
+      c->proc = NULL;
+      // 空闲时回到内核页表：进程的 mm 可能在别的 hart 上被释放
+      if (current_mm()) {
+        mm_switch(NULL);
       }
-      release(&p->lock);
     }
+    release(&p->lock);
   }
 }
 
+// sched: switch from the current process to this hart's scheduler. The
+// caller holds p->lock (and nothing else) and has changed p->state. intena
+// belongs to the process, not the hart, so carry it across the switch: the
+// process may come back on another hart.
 static void sched(void) {
   struct proc *p = myproc();
-  struct cpu *c = mycpu();
   if (!p) {
     return;
   }
-  swtch(&p->context, &c->context);
+  if (!holding(&p->lock)) {
+    panic("sched: p->lock not held");
+  }
+  if (mycpu()->noff != 1) {
+    panic("sched: locks held");
+  }
+  if (p->state == RUNNING) {
+    panic("sched: running");
+  }
+  int intena = mycpu()->intena;
+  swtch(&p->context, &mycpu()->context);
+  mycpu()->intena = intena;
 }
 
 void yield(void) {
@@ -140,6 +296,7 @@ void yield(void) {
   }
   acquire(&p->lock);
   p->state = RUNNABLE;
+  sched_enqueue(p, cpuid());
   sched();
   release(&p->lock);
 }
@@ -149,12 +306,15 @@ void exit_process(int status) {
   if (!p) {
     return;
   }
-  acquire(&p->lock);
-  p->xstate = status;
-  p->state = ZOMBIE;
+  // 父进程可能正在 wait_process 中以 proc_list_lock 睡眠
+  acquire(&proc_list_lock);
   if (p->parent) {
     wakeup(p->parent);
   }
+  acquire(&p->lock);
+  p->xstate = status;
+  p->state = ZOMBIE;
+  release(&proc_list_lock);
   sched();
   // should not return
   release(&p->lock);
@@ -164,10 +324,10 @@ void exit_process(int status) {
 int wait_process(int *status) {
   struct proc *p = myproc();
   int havekids;
+  acquire(&proc_list_lock);
   for (;;) {
     havekids = 0;
-    for (int i = 0; i < NPROC; ++i) {
-      struct proc *cp = &proc_table[i];
+    for (struct proc *cp = proc_list; cp; cp = cp->next) {
       acquire(&cp->lock);
       if (cp->parent == p) {
         havekids = 1;
@@ -176,51 +336,153 @@ int wait_process(int *status) {
           if (status) {
             *status = cp->xstate;
           }
-          cp->state = UNUSED;
           cp->parent = NULL;
           release(&cp->lock);
+          uint8_t *kstack = free_process(cp);
+          release(&proc_list_lock);
+          kstack_free(kstack);
+          acquire(&proc_list_lock);
+          nproc_live--;
+          release(&proc_list_lock);
           return pid;
         }
       }
       release(&cp->lock);
     }
     if (!havekids) {
+      release(&proc_list_lock);
       return -1;
     }
-    sleep_on(p, NULL);
+    sleep_on(p, &proc_list_lock);
   }
 }
 
+// sleep_on: atomically release lk and sleep on chan; lk is held again on
+// return. The process is put on chan's wait queue and takes p->lock before
+// lk is released, so a waker that changed the condition under lk either
+// finds it there and then waits on p->lock until it has switched away, or
+// ran before it checked the condition. lk may be NULL, but not p->lock.
 void sleep_on(void *chan, struct spinlock *lk) {
   struct proc *p = myproc();
   if (!p) return;
-  if (lk && lk != &p->lock) {
-    acquire(&p->lock);
-    release(lk);
-  } else if (lk == NULL) {
-    acquire(&p->lock);
+  if (lk == &p->lock) {
+    panic("sleep_on: lk is p->lock");
   }
+  struct waitq *wq = waitq_of(chan);
+  acquire(&wq->lock);
   p->chan = chan;
+  p->wq_next = NULL;
+  struct proc **pp = &wq->head;
+  while (*pp) {
+    pp = &(*pp)->wq_next;
+  }
+  *pp = p;  // 队尾入队，wakeup_one 按睡眠先后唤醒
+  acquire(&p->lock);
+  release(&wq->lock);
+  if (lk) {
+    release(lk);
+  }
   p->state = SLEEPING;
   sched();
-  p->chan = NULL;
-  if (lk && lk != &p->lock) {
-    release(&p->lock);
+  // 唤醒者已把 p 从等待队列摘下并清掉 chan
+  release(&p->lock);
+  if (lk) {
     acquire(lk);
-  } else {
+  }
+}
+
+// wake: dequeue and wake the sleepers on chan, or only the oldest one.
+// Returns how many were woken. Only chan's bucket is looked at.
+static int wake(void *chan, int all) {
+  struct waitq *wq = waitq_of(chan);
+  if (!wq->head) {
+    // 不加锁先看一眼：睡眠者在放开调用者的锁之前就已入队，
+    // 唤醒者改条件时拿过同一把锁，所以这里一定看得到它
+    return 0;
+  }
+  int woken = 0;
+  acquire(&wq->lock);
+  for (struct proc **pp = &wq->head; *pp;) {
+    struct proc *p = *pp;
+    if (p->chan != chan) {
+      pp = &p->wq_next;
+      continue;
+    }
+    *pp = p->wq_next;
+    p->wq_next = NULL;
+    acquire(&p->lock);
+    if (p->state != SLEEPING) {
+      panic("wakeup: queued process not sleeping");
+    }
+    p->chan = NULL;
+    p->state = RUNNABLE;
+    // 回到上次运行的 hart，缓存还是热的
+    sched_enqueue(p, __atomic_load_n(&p->last_cpu, __ATOMIC_RELAXED));
     release(&p->lock);
+    woken++;
+    if (!all) {
+      break;
+    }
   }
+  release(&wq->lock);
+  return woken;
 }
 
-void wakeup(void *chan) {
-  for (int i = 0; i < NPROC; ++i) {
-    struct proc *p = &proc_table[i];
+void wakeup(void *chan) { wake(chan, 1); }
+
+// wakeup_one: wake only the longest sleeper on chan, for conditions that
+// one waiter can consume (a token, a free slot). Returns 1 if one was woken.
+int wakeup_one(void *chan) { return wake(chan, 0); }
+
+// set_priority: move a process to another level. A queued process is
+// requeued at the tail of its new level.
+int set_priority(int pid, int prio) {
+  if (prio < 0 || prio >= NPRIO) {
+    return -1;
+  }
+  acquire(&proc_list_lock);
+  for (struct proc *p = proc_list; p; p = p->next) {
+    if (p->pid != pid) {
+      continue;
+    }
+    acquire(&p->lock);
+    if (p->state == RUNNABLE && sched_dequeue(p)) {
+      p->priority = prio;
+      sched_enqueue(p, p->cpu);
+    } else {
+      p->priority = prio;
+    }
+    release(&p->lock);
+    release(&proc_list_lock);
+    return 0;
+  }
+  release(&proc_list_lock);
+  return -1;
+}
+
+// set_affinity: restrict a process to the harts in mask; at least one of
+// them must be online. A queued process on a hart outside the mask moves
+// now, a running one the next time it is queued.
+int set_affinity(int pid, uint64_t mask) {
+  if (!(mask & ((1UL << ncpu_online()) - 1))) {
+    return -1;
+  }
+  acquire(&proc_list_lock);
+  for (struct proc *p = proc_list; p; p = p->next) {
+    if (p->pid != pid) {
+      continue;
+    }
     acquire(&p->lock);
-    if (p->state == SLEEPING && p->chan == chan) {
-      p->state = RUNNABLE;
+    p->affinity = mask;
+    if (p->state == RUNNABLE && !((mask >> p->cpu) & 1) && sched_dequeue(p)) {
+      sched_enqueue(p, p->cpu);
     }
     release(&p->lock);
+    release(&proc_list_lock);
+    return 0;
   }
+  release(&proc_list_lock);
+  return -1;
 }
 
 // Expose tick count so that tests can measure scheduler progress.
@@ -228,11 +490,15 @@ extern volatile uint64_t kernel_ticks;
 uint64_t ticks_since_boot(void) { return kernel_ticks; }
 
 void debug_proc_table(void) {
-  printf("=== Process Table ===\n");
-  for (int i = 0; i < NPROC; ++i) {
-    struct proc *p = &proc_table[i];
+  printf("=== Process Table (%d harts) ===\n", ncpu_online());
+  acquire(&proc_list_lock);
+  for (struct proc *p = proc_list; p; p = p->next) {
     if (p->state != UNUSED) {
-      printf("PID:%d State:%d Name:%s\n", p->pid, p->state, p->name);
+      printf("PID:%d State:%d Prio:%d CPU:%d Aff:%#lx Name:%s KStack:%luB\n", p->pid,
+             p->state, p->priority, __atomic_load_n(&p->last_cpu, __ATOMIC_RELAXED),
+             (unsigned long)p->affinity, p->name,
+             (unsigned long)kstack_high_water(p->kstack));
     }
   }
+  release(&proc_list_lock);
 }
\ No newline at end of file
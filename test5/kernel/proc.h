@@ -1,11 +1,25 @@
 #pragma once
 
 #include <stdint.h>
+#include "spinlock.h"
 #include "trap.h"
 
-// Maximum number of processes supported by the tiny kernel.
+// Maximum number of live processes. struct proc and kernel stacks are
+// allocated on demand, so this is only a cap, not a preallocation.
 #define NPROC 16
-#define KSTACK_SIZE 4096
+
+// Kernel stack cap. Stacks start with one resident page and grow on fault
+// up to this size (see kstack.h); override with -DKSTACK_SIZE=...
+#ifndef KSTACK_SIZE
+#define KSTACK_SIZE (16 * 1024)
+#endif
+
+// Scheduling priorities: 0 runs first. New processes start at PRIO_DEFAULT.
+#define NPRIO        32
+#define PRIO_DEFAULT 16
+
+// Affinity: bit i set = may run on hart i. New processes may run anywhere.
+#define AFFINITY_ALL (~0UL)
 
 // Process states.
 enum procstate {
@@ -33,9 +47,7 @@ struct context {
   uint64_t s11;
 };
 
-struct spinlock {
-  volatile int locked;
-};
+struct mm;
 
 struct proc {
   struct spinlock lock;
@@ -50,14 +62,57 @@ struct proc {
   int parent_pid;
   struct proc *parent;
   uint8_t *kstack;
+  struct mm *mm;          // address space (vm.h), NULL = kernel page table
+  int priority;           // 0..NPRIO-1, lower runs first
+  uint64_t affinity;      // harts allowed to run it (AFFINITY_ALL)
+  int cpu;                // hart whose run queue holds it, changed under that queue's lock
+  int last_cpu;           // hart it last ran on, -1 before the first run; set by
+                          // sched_pick without p->lock, so access it atomically
+  struct proc *rq_next;   // run-queue FIFO link, valid while queued
+  struct proc *wq_next;   // wait-queue link, valid while sleeping on chan
+  struct proc *next;      // all-process list
 };
 
 struct cpu {
   struct proc *proc;
   struct context context; // swtch() here to enter scheduler
+  int noff;               // push_off nesting depth
+  int intena;             // were interrupts enabled before the first push_off?
 };
 
-extern struct proc proc_table[NPROC];
+// Run queues (sched.c), one per hart: per-priority FIFOs and a bitmap of
+// non-empty levels. A process is queued exactly while it is RUNNABLE;
+// callers hold p->lock around the state change and the queue operation.
+// Each queue has its own lock, taken inside p->lock. Its owner takes it on
+// every pick and idle harts take it to steal, so it is a ticket lock.
+struct runqueue {
+  struct ticketlock lock;
+  int cpu;                // owning hart, -1 for a private queue
+  uint32_t bitmap;
+  int nr;
+  struct proc *head[NPRIO];
+  struct proc *tail[NPRIO];
+  // Balancing counters, written only by the owning hart.
+  uint64_t steals;        // steals that moved at least one process here
+  uint64_t stolen;        // processes moved here by those steals
+  uint64_t migrations;    // picks of a process that last ran on another hart
+};
+
+extern struct proc *proc_list;
+
+void            runq_init(struct runqueue *rq, int cpu);
+void            runq_push(struct runqueue *rq, struct proc *p);
+struct proc    *runq_pop(struct runqueue *rq);
+int             runq_remove(struct runqueue *rq, struct proc *p);
+
+// Per-hart queues. sched_enqueue puts p on hint's queue if p's affinity
+// allows it, otherwise on the shortest allowed queue. sched_dequeue takes
+// p off whichever queue holds it (0 if none). Both need p->lock.
+void            sched_init(void);
+void            sched_enqueue(struct proc *p, int hint);
+int             sched_dequeue(struct proc *p);
+struct proc    *sched_pick(void);
+void            sched_dump(void);
 
 void            proc_init(void);
 int             create_process(void (*entry)(void));
@@ -68,11 +123,16 @@ void            yield(void);
 struct proc    *myproc(void);
 struct cpu     *mycpu(void);
 struct proc    *init_bootproc(void);
-void            init_lock(struct spinlock *lk);
-void            acquire(struct spinlock *lk);
-void            release(struct spinlock *lk);
 void            sleep_on(void *chan, struct spinlock *lk);
 void            wakeup(void *chan);
+int             wakeup_one(void *chan);
+int             set_priority(int pid, int prio);
+int             set_affinity(int pid, uint64_t mask);
 uint64_t        ticks_since_boot(void);
 void            scheduler_init(void);
-void            debug_proc_table(void);
\ No newline at end of file
+void            debug_proc_table(void);
+
+// SMP bring-up (start.c): harts other than 0 wait in sstart until kmain
+// calls start_other_harts, then enter scheduler().
+void            start_other_harts(void);
+int             ncpu_online(void);
\ No newline at end of file
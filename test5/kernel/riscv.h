@@ -18,6 +18,8 @@ static inline void     w_mtvec(uint64_t x){ asm volatile("csrw mtvec, %0" :: "r"
 static inline uint64_t r_mepc(void){ uint64_t x; asm volatile("csrr %0, mepc" : "=r"(x)); return x; }
 static inline void     w_mepc(uint64_t x){ asm volatile("csrw mepc, %0" :: "r"(x)); }
 static inline uint64_t r_mcause(void){ uint64_t x; asm volatile("csrr %0, mcause" : "=r"(x)); return x; }
+static inline uint64_t r_misa(void){ uint64_t x; asm volatile("csrr %0, misa" : "=r"(x)); return x; }
+#define MISA_V (1UL << ('V' - 'A'))
 static inline uint64_t r_mhartid(void){ uint64_t x; asm volatile("csrr %0, mhartid" : "=r"(x)); return x; }
 static inline void     w_mscratch(uint64_t x){ asm volatile("csrw mscratch, %0" :: "r"(x)); }
 static inline uint64_t r_mcounteren(void){ uint64_t x; asm volatile("csrr %0, mcounteren" : "=r"(x)); return x; }
@@ -31,6 +33,7 @@ static inline void     w_sstatus(uint64_t x){ asm volatile("csrw sstatus, %0" ::
 static inline uint64_t r_sie(void){ uint64_t x; asm volatile("csrr %0, sie" : "=r"(x)); return x; }
 static inline void     w_sie(uint64_t x){ asm volatile("csrw sie, %0" :: "r"(x)); }
 static inline void     w_stvec(uint64_t x){ asm volatile("csrw stvec, %0" :: "r"(x)); }
+static inline void     w_sscratch(uint64_t x){ asm volatile("csrw sscratch, %0" :: "r"(x)); }
 static inline uint64_t r_scause(void){ uint64_t x; asm volatile("csrr %0, scause" : "=r"(x)); return x; }
 static inline uint64_t r_sepc(void){ uint64_t x; asm volatile("csrr %0, sepc" : "=r"(x)); return x; }
 static inline void     w_sepc(uint64_t x){ asm volatile("csrw sepc, %0" :: "r"(x)); }
@@ -39,9 +42,54 @@ static inline uint64_t r_sip(void){ uint64_t x; asm volatile("csrr %0, sip" : "=
 static inline void     w_sip(uint64_t x){ asm volatile("csrw sip, %0" :: "r"(x)); }
 static inline uint64_t r_time(void){ uint64_t x; asm volatile("rdtime %0":"=r"(x)); return x; }
 static inline void     w_satp(uint64_t x){ asm volatile("csrw satp, %0" :: "r"(x)); }
+static inline uint64_t r_satp(void){ uint64_t x; asm volatile("csrr %0, satp" : "=r"(x)); return x; }
+
+// Flush the whole TLB, or only the entries for one virtual address.
+static inline void sfence_vma_all(void){ asm volatile("sfence.vma zero, zero" ::: "memory"); }
+static inline void sfence_vma_va(uint64_t va){ asm volatile("sfence.vma %0, zero" :: "r"(va) : "memory"); }
+
+// Zicboz: zero the whole cache block containing addr (.insn so the assembler needn't know the extension).
+static inline void cbo_zero(void *addr){ asm volatile(".insn i 0x0F, 2, x0, %0, 4" :: "r"(addr) : "memory"); }
+
+// M-mode only. menvcfg.CBZE is writable only when Zicboz is implemented, and
+// setting it also lets S-mode execute cbo.zero. The block size is the number
+// of bytes one cbo.zero clears in a 0xFF-filled, CBO_PROBE_MAX-aligned buffer.
+// Returns 0 when Zicboz is absent.
+#define MENVCFG_CBZE  (1UL << 7)
+#define CBO_PROBE_MAX 512
+static inline int zicboz_probe(uint8_t *buf) {
+  // menvcfg only exists from privileged spec 1.12; touching it on an older
+  // hart raises illegal-instruction. While probing, mtvec points at a stub
+  // that skips the faulting instruction, so cfg then stays 0.
+  uint64_t cfg = 0, old_mtvec, old_mstatus;
+  asm volatile("csrrci %2, mstatus, 8\n\t"  // MIE off: the stub handles exceptions only
+               "la    t0, 1f\n\t"
+               "csrrw %1, mtvec, t0\n\t"
+               "csrs  0x30a, %3\n\t"
+               "csrr  %0, 0x30a\n\t"
+               "j     2f\n\t"
+               ".align 2\n"
+               "1:\n\t"
+               "csrr  t0, mepc\n\t"
+               "addi  t0, t0, 4\n\t"
+               "csrw  mepc, t0\n\t"
+               "mret\n"
+               "2:\n\t"
+               "csrw  mtvec, %1\n\t"
+               "csrw  mstatus, %2"
+               : "+r"(cfg), "=&r"(old_mtvec), "=&r"(old_mstatus)
+               : "r"(MENVCFG_CBZE) : "t0", "memory");
+  if (!(cfg & MENVCFG_CBZE)) return 0;
+  for (int i = 0; i < CBO_PROBE_MAX; i++) buf[i] = 0xFF;
+  cbo_zero(buf);
+  int n = 0;
+  while (n < CBO_PROBE_MAX && buf[n] == 0) n++;
+  return n;
+}
 
 // ---------------- SSTATUS/SIE/SIP bits ----------------
 #define SSTATUS_SIE   (1UL << 1)   // global S-mode interrupt enable
+#define SSTATUS_SUM   (1UL << 18)  // S-mode may access U pages
 #define SIE_SEIE      (1UL << 9)   // external
 #define SIE_STIE      (1UL << 5)   // timer
 #define SIE_SSIE      (1UL << 1)   // software
@@ -55,6 +103,7 @@ static inline void     w_satp(uint64_t x){ asm volatile("csrw satp, %0" :: "r"(x
 #define MSTATUS_MPIE      (1UL << 7)
 #define MSTATUS_SPIE      (1UL << 5)
 #define MSTATUS_SPP       (1UL << 8)
+#define MSTATUS_VS_INIT   (1UL << 9)    // mstatus.VS = Initial: vector instructions allowed
 #define MSTATUS_MPP_MASK  (3UL << 11)
 #define MSTATUS_MPP_U     (0UL << 11)
 #define MSTATUS_MPP_S     (1UL << 11)
@@ -78,6 +127,26 @@ static inline void     w_satp(uint64_t x){ asm volatile("csrw satp, %0" :: "r"(x
 static inline void intr_on(void){ w_sstatus(r_sstatus() | SSTATUS_SIE); }
 static inline void intr_off(void){ w_sstatus(r_sstatus() & ~SSTATUS_SIE); }
 
+// Save-and-disable / restore of SIE, used around per-CPU data.
+static inline uint64_t intr_save(void){ uint64_t x; asm volatile("csrrc %0, sstatus, %1" : "=r"(x) : "r"(SSTATUS_SIE) : "memory"); return x & SSTATUS_SIE; }
+static inline void     intr_restore(uint64_t x){ if (x) asm volatile("csrs sstatus, %0" :: "r"(x) : "memory"); }
+
+// ---------------- per-hart identity / counters ----------------
+// Harts 0..NCPU-1 are brought up; entry.S parks any others. Keep in sync
+// with NCPU in entry.S and the boot-stack area in kernel.ld.
+#define NCPU 8
+
+// tp holds the hart id (set in entry.S before dropping to S-mode). Kernel
+// code never changes tp, and kernelvec does not restore it, so it stays
+// right when a process moves to another hart.
+static inline uint64_t r_tp(void){ uint64_t x; asm volatile("mv %0, tp" : "=r"(x)); return x; }
+static inline int      cpuid(void){ return (int)r_tp(); }
+static inline uint64_t r_cycle(void){ uint64_t x; asm volatile("rdcycle %0" : "=r"(x)); return x; }
+
+// Zihintpause pause, for spin-wait loops. It is encoded as fence w,0, so harts
+// without the extension run it as an ordinary (harmless) fence.
+static inline void cpu_relax(void){ asm volatile(".insn i 0x0F, 0, x0, x0, 0x010" ::: "memory"); }
+
 // ---------------- CLINT MMIO layout ----------------
 #define CLINT_BASE              0x02000000UL
 #define CLINT_MTIMECMP(hart)   (CLINT_BASE + 0x4000 + 8 * (hart))
@@ -1,9 +1,262 @@
 // kernel/sched.c
+// Scheduling policy: the time slice and the per-hart run queues.
+//
+// Each run queue keeps one FIFO per priority level plus a bitmap with bit i
+// set while level i is non-empty. Lower numbers run first, so picking the
+// next process is one count-trailing-zeros on the bitmap and one list pop,
+// independent of how many processes exist.
+//
+// Every hart has its own queue. Created, yielding and woken processes go on
+// the queue of the hart they are on or last ran on, so harts normally touch
+// only their own queue. A hart that finds its queue empty steals about half
+// of the processes of the busiest queue (sched_pick).
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "proc.h"
+#include "riscv.h"
 
-static int slice = 0;
+static int slice[NCPU];  // per hart, only touched from its timer interrupt
+
+static struct runqueue runqs[NCPU];
 
 bool should_yield(void) {
   // Hand back the CPU every 10 timer ticks.
-  return (++slice % 10) == 0;
-}
\ No newline at end of file
+  return (++slice[cpuid()] % 10) == 0;
+}
+
+// Index of the lowest set bit; x must be non-zero. With Zbb
+// (-march=..._zbb) GCC emits a single ctzw, otherwise use a de Bruijn
+// multiply instead of the libgcc loop.
+static inline int rq_ctz(uint32_t x) {
+#ifdef __riscv_zbb
+  return __builtin_ctz(x);
+#else
+  static const uint8_t debruijn[32] = {
+    0,  1,  28, 2,  29, 14, 24, 3,  30, 22, 20, 15, 25, 17, 4,  8,
+    31, 27, 13, 23, 21, 19, 16, 7,  26, 12, 18, 6,  11, 5,  10, 9,
+  };
+  return debruijn[((x & -x) * 0x077CB531U) >> 27];
+#endif
+}
+
+// 调用者持有 rq->lock
+static void rq_append(struct runqueue *rq, struct proc *p) {
+  int prio = p->priority;
+  p->rq_next = NULL;
+  p->cpu = rq->cpu;
+  if (rq->tail[prio]) {
+    rq->tail[prio]->rq_next = p;
+  } else {
+    rq->head[prio] = p;
+    rq->bitmap |= 1U << prio;
+  }
+  rq->tail[prio] = p;
+  rq->nr++;
+}
+
+// 调用者持有 rq->lock；prev 是 p 在同一优先级链表里的前驱，p 在队首时为 NULL
+static void rq_unlink(struct runqueue *rq, struct proc *p, struct proc *prev) {
+  int prio = p->priority;
+  if (prev) {
+    prev->rq_next = p->rq_next;
+  } else {
+    rq->head[prio] = p->rq_next;
+  }
+  if (rq->tail[prio] == p) {
+    rq->tail[prio] = prev;
+  }
+  if (!rq->head[prio]) {
+    rq->bitmap &= ~(1U << prio);
+  }
+  p->rq_next = NULL;
+  rq->nr--;
+}
+
+// 调用者持有 rq->lock
+static int rq_remove_locked(struct runqueue *rq, struct proc *p) {
+  struct proc *prev = NULL;
+  for (struct proc *q = rq->head[p->priority]; q; prev = q, q = q->rq_next) {
+    if (q == p) {
+      rq_unlink(rq, p, prev);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void runq_init(struct runqueue *rq, int cpu) {
+  init_ticketlock(&rq->lock, "runq");
+  rq->cpu = cpu;
+  rq->bitmap = 0;
+  rq->nr = 0;
+  for (int i = 0; i < NPRIO; i++) {
+    rq->head[i] = rq->tail[i] = NULL;
+  }
+  rq->steals = rq->stolen = rq->migrations = 0;
+}
+
+// runq_push: append p to the tail of its priority level. The caller holds
+// p->lock and has already marked p RUNNABLE.
+void runq_push(struct runqueue *rq, struct proc *p) {
+  ticket_acquire(&rq->lock);
+  rq_append(rq, p);
+  ticket_release(&rq->lock);
+}
+
+// runq_pop: remove and return the oldest process of the highest non-empty
+// priority, or NULL if nothing is runnable.
+struct proc *runq_pop(struct runqueue *rq) {
+  if (!rq->bitmap) {
+    return NULL;  // unlocked peek so idle harts do not hammer the lock
+  }
+  ticket_acquire(&rq->lock);
+  struct proc *p = NULL;
+  if (rq->bitmap) {
+    p = rq->head[rq_ctz(rq->bitmap)];
+    rq_unlink(rq, p, NULL);
+  }
+  ticket_release(&rq->lock);
+  return p;
+}
+
+// runq_remove: unlink p from rq (priority changes and teardown). Returns 0
+// if p was not queued there.
+int runq_remove(struct runqueue *rq, struct proc *p) {
+  ticket_acquire(&rq->lock);
+  int found = rq_remove_locked(rq, p);
+  ticket_release(&rq->lock);
+  return found;
+}
+
+static inline int cpu_allowed(struct proc *p, int cpu) {
+  return (p->affinity >> cpu) & 1;
+}
+
+void sched_init(void) {
+  for (int i = 0; i < NCPU; i++) {
+    runq_init(&runqs[i], i);
+  }
+}
+
+void sched_enqueue(struct proc *p, int hint) {
+  int n = ncpu_online();
+  int cpu = hint;
+  if (cpu < 0 || cpu >= n || !cpu_allowed(p, cpu)) {
+    cpu = -1;
+    for (int i = 0; i < n; i++) {
+      if (cpu_allowed(p, i) && (cpu < 0 || runqs[i].nr < runqs[cpu].nr)) {
+        cpu = i;
+      }
+    }
+    if (cpu < 0) {
+      cpu = 0;  // set_affinity 保证至少有一个在线 hart，这里只是兜底
+    }
+  }
+  runq_push(&runqs[cpu], p);
+}
+
+// p->cpu 只在持有对应队列锁时改变：加锁后若 p->cpu 已变，说明刚被偷走，换队列重试
+int sched_dequeue(struct proc *p) {
+  for (;;) {
+    int cpu = p->cpu;
+    if (cpu < 0 || cpu >= NCPU) {
+      return 0;
+    }
+    struct runqueue *rq = &runqs[cpu];
+    ticket_acquire(&rq->lock);
+    if (p->cpu == cpu) {
+      int found = rq_remove_locked(rq, p);
+      ticket_release(&rq->lock);
+      return found;
+    }
+    ticket_release(&rq->lock);
+  }
+}
+
+// runq_steal_from: move up to half (rounded up) of src's processes that may
+// run on dst's hart, highest priority first: those are the ones that
+// would otherwise wait longest for src's hart. Both queue locks are taken,
+// lower hart first.
+static int runq_steal_from(struct runqueue *dst, struct runqueue *src) {
+  struct runqueue *first = dst->cpu < src->cpu ? dst : src;
+  struct runqueue *second = first == dst ? src : dst;
+  ticket_acquire(&first->lock);
+  ticket_acquire(&second->lock);
+  int want = (src->nr + 1) / 2;
+  int moved = 0;
+  uint32_t levels = src->bitmap;
+  while (levels && moved < want) {
+    int prio = rq_ctz(levels);
+    levels &= levels - 1;
+    struct proc *prev = NULL;
+    for (struct proc *p = src->head[prio], *next; p && moved < want; p = next) {
+      next = p->rq_next;
+      if (!cpu_allowed(p, dst->cpu)) {
+        prev = p;
+        continue;
+      }
+      rq_unlink(src, p, prev);
+      rq_append(dst, p);
+      moved++;
+    }
+  }
+  ticket_release(&second->lock);
+  ticket_release(&first->lock);
+  return moved;
+}
+
+// runq_steal: rq's hart is idle. Try the busiest other queue; if none of its
+// processes may run here, the next busiest, and so on.
+static int runq_steal(struct runqueue *rq) {
+  int n = ncpu_online();
+  uint32_t tried = 1U << rq->cpu;
+  for (;;) {
+    struct runqueue *victim = NULL;
+    for (int i = 0; i < n; i++) {
+      if (!((tried >> i) & 1) && runqs[i].nr > 0 && (!victim || runqs[i].nr > victim->nr)) {
+        victim = &runqs[i];
+      }
+    }
+    if (!victim) {
+      return 0;
+    }
+    tried |= 1U << victim->cpu;
+    int moved = runq_steal_from(rq, victim);
+    if (moved) {
+      rq->steals++;
+      rq->stolen += moved;
+      return moved;
+    }
+  }
+}
+
+// sched_pick: next process for this hart's scheduler, stealing when the
+// local queue is empty. NULL means there is nothing to run anywhere.
+struct proc *sched_pick(void) {
+  int self = cpuid();  // 调度器不会迁移
+  struct runqueue *rq = &runqs[self];
+  struct proc *p = runq_pop(rq);
+  if (!p && runq_steal(rq)) {
+    p = runq_pop(rq);
+  }
+  if (p) {
+    // 这里还没拿 p->lock，last_cpu 一律原子访问
+    int last = __atomic_exchange_n(&p->last_cpu, self, __ATOMIC_RELAXED);
+    if (last >= 0 && last != self) {
+      rq->migrations++;
+    }
+  }
+  return p;
+}
+
+void sched_dump(void) {
+  int n = ncpu_online();
+  printf("=== Run queues (%d harts) ===\n", n);
+  for (int i = 0; i < n; i++) {
+    struct runqueue *rq = &runqs[i];
+    printf("hart %d: queued %d, steals %lu (%lu procs), migrations %lu\n", i, rq->nr,
+           (unsigned long)rq->steals, (unsigned long)rq->stolen,
+           (unsigned long)rq->migrations);
+  }
+}
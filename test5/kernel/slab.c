@@ -0,0 +1,283 @@
+/**
+ * kernel/slab.c - slab 对象缓存
+ *
+ * 实现原理：
+ * 1. 每个 kmem_cache 管理一种固定大小的对象
+ * 2. slab = 从 PMM 取得的 2^order 个连续页，开头是 slab 头，后面是对象数组
+ * 3. slab 头后面跟一个 uint16_t 的空闲下标链表，不在对象内部写链接指针，
+ *    因此释放回来的对象保持“已构造”状态，构造函数只在新建 slab 时调用
+ *
+ * 核心设计决策：
+ * - 对象默认按 cache line 对齐，避免不同对象之间伪共享
+ * - slab 按自身大小对齐（buddy 保证），释放时由对象地址直接算出 slab 头
+ * - 每个缓存维护 partial/full/empty 三个链表，分配优先走 partial；
+ *   只保留一个空 slab，多余的立即还给 PMM，内存随实际使用量伸缩
+ */
+
+#include "slab.h"
+#include "pmm.h"
+#include "printf.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define PAGE_SIZE 4096
+#define SLAB_MAX_ORDER 3       /* slab 最大 8 页 */
+#define SLAB_MIN_OBJS  8       /* 每个 slab 至少容纳的对象数（尽量满足） */
+#define SLAB_FREE_END  0xFFFF  /* 空闲下标链表结束标记 */
+
+struct slab {
+    struct kmem_cache *cache;
+    struct slab *next;
+    struct slab *prev;
+    uint16_t free_head;   /* 第一个空闲对象的下标 */
+    uint16_t inuse;       /* 已分配对象数 */
+    /* 后接 uint16_t next_free[objs_per_slab]，再按 align 对齐后是对象数组 */
+};
+
+struct kmem_cache {
+    const char *name;
+    uint32_t obj_size;       /* 对齐后的对象大小 */
+    uint32_t align;
+    uint32_t order;          /* 每个 slab 占 2^order 页 */
+    uint32_t objs_per_slab;
+    uint32_t obj_offset;     /* 第一个对象相对 slab 起始的偏移 */
+    void (*ctor)(void *obj);
+
+    struct slab *partial;    /* 部分使用 */
+    struct slab *full;       /* 全部使用 */
+    struct slab *empty;      /* 全部空闲（最多保留一个） */
+    struct spinlock lock;
+
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t nr_slabs;
+
+    struct kmem_cache *next; /* 全局缓存链表，用于 kmem_cache_dump */
+};
+
+/* “缓存的缓存”：kmem_cache 结构本身也从 slab 分配 */
+static struct kmem_cache cache_cache;
+static struct kmem_cache *cache_list;
+
+static inline void cache_lock(struct kmem_cache *c) {
+    acquire(&c->lock);
+}
+
+static inline void cache_unlock(struct kmem_cache *c) {
+    release(&c->lock);
+}
+
+static inline uint64_t slab_bytes(struct kmem_cache *c) {
+    return (uint64_t)PAGE_SIZE << c->order;
+}
+
+static inline uint16_t *slab_next_free(struct slab *s) {
+    return (uint16_t*)(s + 1);
+}
+
+static inline void *slab_obj(struct kmem_cache *c, struct slab *s, uint32_t idx) {
+    return (char*)s + c->obj_offset + (uint64_t)idx * c->obj_size;
+}
+
+static inline uint32_t align_up(uint32_t x, uint32_t a) {
+    return (x + a - 1) & ~(a - 1);
+}
+
+/* 双向链表操作：head 为链表头指针的地址 */
+static void slab_list_add(struct slab **head, struct slab *s) {
+    s->prev = NULL;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+static void slab_list_del(struct slab **head, struct slab *s) {
+    if (s->prev) s->prev->next = s->next;
+    else *head = s->next;
+    if (s->next) s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
+
+/*
+ * cache_layout - 计算 slab 阶数、每 slab 对象数与对象起始偏移
+ *
+ * 从 0 阶开始找能放下 SLAB_MIN_OBJS 个对象的最小阶，
+ * 放不下时退回 SLAB_MAX_ORDER 并尽量多放
+ */
+static int cache_layout(struct kmem_cache *c) {
+    for (uint32_t order = 0; order <= SLAB_MAX_ORDER; order++) {
+        uint64_t bytes = (uint64_t)PAGE_SIZE << order;
+        uint32_t n = (uint32_t)(bytes / c->obj_size);
+        while (n > 0) {
+            uint32_t hdr = sizeof(struct slab) + n * sizeof(uint16_t);
+            uint32_t off = align_up(hdr, c->align);
+            if (off + (uint64_t)n * c->obj_size <= bytes) {
+                c->order = order;
+                c->objs_per_slab = n;
+                c->obj_offset = off;
+                break;
+            }
+            n--;
+        }
+        if (n >= SLAB_MIN_OBJS || (n > 0 && order == SLAB_MAX_ORDER)) return 0;
+    }
+    return -1;
+}
+
+static int cache_init(struct kmem_cache *c, const char *name, uint32_t size,
+                      uint32_t align, void (*ctor)(void *obj)) {
+    if (align == 0) align = CACHE_LINE_SIZE;
+    if (align < sizeof(void*)) align = sizeof(void*);
+    if (align & (align - 1)) return -1;   /* 必须是 2 的幂 */
+
+    c->name = name;
+    c->align = align;
+    c->obj_size = align_up(size ? size : 1, align);
+    c->ctor = ctor;
+    c->partial = c->full = c->empty = NULL;
+    init_lock(&c->lock, "slab");
+    c->allocs = c->frees = c->nr_slabs = 0;
+    if (cache_layout(c) < 0) return -1;
+
+    c->next = cache_list;
+    cache_list = c;
+    return 0;
+}
+
+/* slab_new - 从 PMM 取页建立新 slab，并对所有对象调用构造函数 */
+static struct slab *slab_new(struct kmem_cache *c) {
+    /* slab 头与对象都会被显式初始化，无需清零 */
+    struct slab *s = (struct slab*)alloc_pages_flags((int)c->order, 0);
+    if (!s) return NULL;
+
+    s->cache = c;
+    s->next = s->prev = NULL;
+    s->inuse = 0;
+    s->free_head = 0;
+    uint16_t *nf = slab_next_free(s);
+    for (uint32_t i = 0; i < c->objs_per_slab; i++) {
+        nf[i] = (i + 1 < c->objs_per_slab) ? (uint16_t)(i + 1) : SLAB_FREE_END;
+        if (c->ctor) c->ctor(slab_obj(c, s, i));
+    }
+    c->nr_slabs++;
+    return s;
+}
+
+/**
+ * kmem_cache_create - 创建对象缓存
+ *
+ * 返回：缓存指针，参数非法或内存不足时返回NULL
+ */
+struct kmem_cache *kmem_cache_create(const char *name, uint32_t size, uint32_t align,
+                                     void (*ctor)(void *obj)) {
+    if (cache_cache.obj_size == 0) {
+        cache_init(&cache_cache, "kmem_cache", sizeof(struct kmem_cache), 0, NULL);
+    }
+    struct kmem_cache *c = (struct kmem_cache*)kmem_cache_alloc(&cache_cache);
+    if (!c) return NULL;
+    if (cache_init(c, name, size, align, ctor) < 0) {
+        printf("slab: cannot create cache %s (size %d, align %d)\n",
+               name, (int)size, (int)align);
+        kmem_cache_free(&cache_cache, c);
+        return NULL;
+    }
+    return c;
+}
+
+/**
+ * kmem_cache_alloc - 从缓存分配一个对象
+ *
+ * 顺序：partial slab -> 保留的空 slab -> 新建 slab
+ */
+void *kmem_cache_alloc(struct kmem_cache *c) {
+    if (!c) return NULL;
+    uint64_t intr = intr_save();
+    cache_lock(c);
+
+    struct slab *s = c->partial;
+    if (!s) {
+        s = c->empty;
+        if (s) {
+            slab_list_del(&c->empty, s);
+        } else {
+            s = slab_new(c);
+            if (!s) {
+                cache_unlock(c);
+                intr_restore(intr);
+                return NULL;
+            }
+        }
+        slab_list_add(&c->partial, s);
+    }
+
+    uint16_t idx = s->free_head;
+    s->free_head = slab_next_free(s)[idx];
+    s->inuse++;
+    if (s->free_head == SLAB_FREE_END) {
+        slab_list_del(&c->partial, s);
+        slab_list_add(&c->full, s);
+    }
+    c->allocs++;
+
+    cache_unlock(c);
+    intr_restore(intr);
+    return slab_obj(c, s, idx);
+}
+
+/**
+ * kmem_cache_free - 把对象还给缓存
+ *
+ * slab 头地址 = 对象地址按 slab 大小向下对齐；
+ * slab 变空时若已有保留的空 slab，则直接把页还给 PMM
+ */
+void kmem_cache_free(struct kmem_cache *c, void *obj) {
+    if (!c || !obj) return;
+
+    struct slab *s = (struct slab*)((uint64_t)obj & ~(slab_bytes(c) - 1));
+    uint64_t off = (uint64_t)obj - (uint64_t)s;
+    if (s->cache != c || off < c->obj_offset || (off - c->obj_offset) % c->obj_size) {
+        printf("slab: kmem_cache_free(%s): bad object %p\n", c->name, obj);
+        return;
+    }
+    uint16_t idx = (uint16_t)((off - c->obj_offset) / c->obj_size);
+
+    uint64_t intr = intr_save();
+    cache_lock(c);
+
+    int was_full = (s->free_head == SLAB_FREE_END);
+    slab_next_free(s)[idx] = s->free_head;
+    s->free_head = idx;
+    s->inuse--;
+    c->frees++;
+
+    if (was_full) {
+        slab_list_del(&c->full, s);
+        slab_list_add(&c->partial, s);
+    }
+    struct slab *release = NULL;
+    if (s->inuse == 0) {
+        slab_list_del(&c->partial, s);
+        if (c->empty) {
+            release = s;
+            c->nr_slabs--;
+        } else {
+            slab_list_add(&c->empty, s);
+        }
+    }
+
+    cache_unlock(c);
+    intr_restore(intr);
+
+    if (release) free_pages_order(release, (int)c->order);
+}
+
+void kmem_cache_dump(void) {
+    printf("slab caches:\n");
+    for (struct kmem_cache *c = cache_list; c; c = c->next) {
+        printf("  %s: obj=%d align=%d objs/slab=%d order=%d slabs=%d live=%d\n",
+               c->name, (int)c->obj_size, (int)c->align, (int)c->objs_per_slab,
+               (int)c->order, (int)c->nr_slabs, (int)(c->allocs - c->frees));
+    }
+}
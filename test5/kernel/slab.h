@@ -0,0 +1,24 @@
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <stdint.h>
+
+#define CACHE_LINE_SIZE 64
+
+struct kmem_cache;
+
+/*
+ * kmem_cache_create - 创建对象缓存
+ *   size  : 对象大小
+ *   align : 对齐要求，0 表示按 cache line 对齐
+ *   ctor  : 构造函数，新 slab 中的每个对象调用一次，可为 NULL
+ *
+ * 约定：对象释放时应处于“已构造”状态，再次分配时不会重新构造。
+ */
+struct kmem_cache *kmem_cache_create(const char *name, uint32_t size, uint32_t align,
+                                     void (*ctor)(void *obj));
+void *kmem_cache_alloc(struct kmem_cache *cache);
+void kmem_cache_free(struct kmem_cache *cache, void *obj);
+void kmem_cache_dump(void);
+
+#endif
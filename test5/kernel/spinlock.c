@@ -0,0 +1,241 @@
+// kernel/spinlock.c
+// Spinlocks, ticket locks, and the per-hart interrupt-off nesting they
+// rely on. Both lock kinds are built on the A extension directly:
+// amoswap.w.aq / amoswap.w.rl for the spinlock word, amoadd.w for tickets.
+#include "spinlock.h"
+#include "proc.h"
+#include "riscv.h"
+#include <stddef.h>
+#include <stdio.h>
+
+static inline uint32_t amoswap_aq(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile("amoswap.w.aq %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+  return old;
+}
+
+static inline void amoswap_rl(volatile uint32_t *p, uint32_t v) {
+  asm volatile("amoswap.w.rl zero, %1, %0" : "+A"(*p) : "r"(v) : "memory");
+}
+
+static inline uint32_t amoadd_aq(volatile uint32_t *p, uint32_t v) {
+  uint32_t old;
+  asm volatile("amoadd.w.aq %0, %2, %1" : "=r"(old), "+A"(*p) : "r"(v) : "memory");
+  return old;
+}
+
+static inline void amoadd_rl(volatile uint32_t *p, uint32_t v) {
+  asm volatile("amoadd.w.rl zero, %1, %0" : "+A"(*p) : "r"(v) : "memory");
+}
+
+// push_off/pop_off: 可嵌套的关中断；最外层 push_off 之前中断是否打开
+// 记在本 hart 的 cpu 结构里，最后一次 pop_off 时恢复
+void push_off(void) {
+  uint64_t old = intr_save();
+  struct cpu *c = mycpu();
+  if (c->noff == 0) {
+    c->intena = old != 0;
+  }
+  c->noff++;
+}
+
+void pop_off(void) {
+  struct cpu *c = mycpu();
+  if (r_sstatus() & SSTATUS_SIE) {
+    panic("pop_off: interruptible");
+  }
+  if (c->noff < 1) {
+    panic("pop_off: unbalanced");
+  }
+  c->noff--;
+  if (c->noff == 0 && c->intena) {
+    intr_on();
+  }
+}
+
+#ifdef LOCK_STATS
+
+// 按名字登记的统计项；表满之后新名字的锁不计数
+#define NLOCKSTAT 32
+#define LOCK_DUMP_TOP 8
+
+static struct lockstat lockstats[NLOCKSTAT];
+static int nlockstat;
+static volatile uint32_t lockstat_word;  // 保护登记表，不能用 spinlock 自己
+
+static int name_eq(const char *a, const char *b) {
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+static struct lockstat *lockstat_get(const char *name) {
+  if (!name) {
+    return NULL;
+  }
+  struct lockstat *st = NULL;
+  uint64_t s = intr_save();
+  while (amoswap_aq(&lockstat_word, 1)) {
+    cpu_relax();
+  }
+  for (int i = 0; i < nlockstat; ++i) {
+    if (name_eq(lockstats[i].name, name)) {
+      st = &lockstats[i];
+      break;
+    }
+  }
+  if (!st && nlockstat < NLOCKSTAT) {
+    st = &lockstats[nlockstat++];
+    st->name = name;
+  }
+  amoswap_rl(&lockstat_word, 0);
+  intr_restore(s);
+  return st;
+}
+
+// 同名的锁可能同时被不同 hart 持有，计数一律用原子操作
+static void stat_acquired(struct lockstat *st, uint64_t *t_acquired, uint64_t spins) {
+  *t_acquired = r_cycle();
+  if (!st) {
+    return;
+  }
+  __atomic_fetch_add(&st->acquired, 1, __ATOMIC_RELAXED);
+  if (spins) {
+    __atomic_fetch_add(&st->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&st->spins, spins, __ATOMIC_RELAXED);
+  }
+}
+
+static void stat_released(struct lockstat *st, uint64_t t_acquired) {
+  if (!st) {
+    return;
+  }
+  uint64_t held = r_cycle() - t_acquired;
+  uint64_t max = __atomic_load_n(&st->max_hold, __ATOMIC_RELAXED);
+  while (held > max && !__atomic_compare_exchange_n(&st->max_hold, &max, held, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+#define STAT_INIT(lk, n)         ((lk)->stat = lockstat_get(n))
+#define STAT_ACQUIRED(lk, spins) stat_acquired((lk)->stat, &(lk)->t_acquired, spins)
+#define STAT_RELEASED(lk)        stat_released((lk)->stat, (lk)->t_acquired)
+
+#else
+
+#define STAT_INIT(lk, n)         ((void)0)
+#define STAT_ACQUIRED(lk, spins) ((void)(spins))
+#define STAT_RELEASED(lk)        ((void)0)
+
+#endif  // LOCK_STATS
+
+void init_lock(struct spinlock *lk, const char *name) {
+  lk->locked = 0;
+  lk->cpu = NULL;
+  lk->name = name;
+  STAT_INIT(lk, name);
+}
+
+// holding: does this hart hold lk? Call with interrupts off.
+int holding(struct spinlock *lk) { return lk->locked && lk->cpu == mycpu(); }
+
+// Test-and-test-and-set: waiters spin on a plain load, which stays in their
+// own cache, and retry the amoswap only once the word reads free.
+void acquire(struct spinlock *lk) {
+  push_off();
+  if (holding(lk)) {
+    panic("acquire: already held");
+  }
+  uint64_t spins = 0;
+  while (amoswap_aq(&lk->locked, 1)) {
+    do {
+      spins++;
+      cpu_relax();
+    } while (lk->locked);
+  }
+  lk->cpu = mycpu();
+  STAT_ACQUIRED(lk, spins);
+}
+
+void release(struct spinlock *lk) {
+  if (!holding(lk)) {
+    panic("release: not held");
+  }
+  STAT_RELEASED(lk);
+  lk->cpu = NULL;
+  amoswap_rl(&lk->locked, 0);
+  pop_off();
+}
+
+void init_ticketlock(struct ticketlock *lk, const char *name) {
+  lk->next = 0;
+  lk->owner = 0;
+  lk->cpu = NULL;
+  lk->name = name;
+  STAT_INIT(lk, name);
+}
+
+int ticket_holding(struct ticketlock *lk) {
+  return lk->next != lk->owner && lk->cpu == mycpu();
+}
+
+// Take a ticket, then wait for owner to reach it. Waiters are served in
+// the order they took tickets; each release is one amoadd, no retry storm.
+void ticket_acquire(struct ticketlock *lk) {
+  push_off();
+  if (ticket_holding(lk)) {
+    panic("ticket_acquire: already held");
+  }
+  uint32_t me = amoadd_aq(&lk->next, 1);
+  uint64_t spins = 0;
+  while (lk->owner != me) {
+    spins++;
+    cpu_relax();
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);  // 等到的是普通 load，补上 acquire
+  lk->cpu = mycpu();
+  STAT_ACQUIRED(lk, spins);
+}
+
+void ticket_release(struct ticketlock *lk) {
+  if (!ticket_holding(lk)) {
+    panic("ticket_release: not held");
+  }
+  STAT_RELEASED(lk);
+  lk->cpu = NULL;
+  amoadd_rl(&lk->owner, 1);
+  pop_off();
+}
+
+// lock_dump: the LOCK_DUMP_TOP names with the most contended acquisitions,
+// ties broken by total acquisitions.
+void lock_dump(void) {
+#ifdef LOCK_STATS
+  int n = nlockstat;
+  struct lockstat *order[NLOCKSTAT];
+  for (int i = 0; i < n; ++i) {
+    struct lockstat *st = &lockstats[i];
+    int j = i;
+    for (; j > 0 && (order[j - 1]->contended < st->contended ||
+                     (order[j - 1]->contended == st->contended &&
+                      order[j - 1]->acquired < st->acquired));
+         --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = st;
+  }
+  printf("locks: %d names, hottest first\n", n);
+  for (int i = 0; i < n && i < LOCK_DUMP_TOP && order[i]->acquired; ++i) {
+    struct lockstat *st = order[i];
+    printf("  %s: acquired %lu, contended %lu (%lu%%), spins/contended %lu, max hold %lu cycles\n",
+           st->name, (unsigned long)st->acquired, (unsigned long)st->contended,
+           (unsigned long)(st->contended * 100 / st->acquired),
+           (unsigned long)(st->contended ? st->spins / st->contended : 0),
+           (unsigned long)st->max_hold);
+  }
+#else
+  printf("locks: no statistics (build with make LOCK_STATS=1)\n");
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Spinlocks keep interrupts off while held (push_off/pop_off nest per hart).
+//
+// struct spinlock is a test-and-test-and-set lock on amoswap.w: cheapest
+// when uncontended. struct ticketlock hands the lock out in arrival order
+// (amoadd.w on a ticket counter), so a hart cannot be starved by others
+// re-taking the lock; use it for locks every hart hits, like the run queue.
+//
+// make LOCK_STATS=1 adds counters: every lock is given a name at init and
+// locks with the same name (all p->lock, say) share one struct lockstat.
+// lock_dump prints the most contended names.
+struct cpu;
+struct lockstat;
+
+struct spinlock {
+  volatile uint32_t locked;
+  struct cpu *cpu;          // holder, for holding() checks
+  const char *name;
+#ifdef LOCK_STATS
+  struct lockstat *stat;
+  uint64_t t_acquired;      // rdcycle at acquire, for the hold time
+#endif
+};
+
+struct ticketlock {
+  volatile uint32_t next;   // next ticket to hand out
+  volatile uint32_t owner;  // ticket being served
+  struct cpu *cpu;
+  const char *name;
+#ifdef LOCK_STATS
+  struct lockstat *stat;
+  uint64_t t_acquired;
+#endif
+};
+
+struct lockstat {
+  const char *name;
+  uint64_t acquired;        // acquisitions
+  uint64_t contended;       // acquisitions that found the lock taken
+  uint64_t spins;           // wait-loop iterations over all contended ones
+  uint64_t max_hold;        // longest hold, in cycles
+};
+
+void            init_lock(struct spinlock *lk, const char *name);
+void            acquire(struct spinlock *lk);
+void            release(struct spinlock *lk);
+int             holding(struct spinlock *lk);
+
+void            init_ticketlock(struct ticketlock *lk, const char *name);
+void            ticket_acquire(struct ticketlock *lk);
+void            ticket_release(struct ticketlock *lk);
+int             ticket_holding(struct ticketlock *lk);
+
+void            push_off(void);
+void            pop_off(void);
+void            lock_dump(void);
@@ -1,6 +1,10 @@
 // kernel/start.c
 #include "riscv.h"
 #include "trap.h"
+#include "pmm.h"
+#include "proc.h"
+#include "kvminit.h"
+#include "vm.h"
 #include <stdint.h>
 
 extern void machinevec(void);
@@ -14,6 +18,13 @@ void kmain(void);
 
 static void sstart(void) __attribute__((noreturn));
 
+/* timervec 的每 hart 暂存栈（mscratch 指向顶部），M 模式不经过页表 */
+static uint64_t timer_scratch[NCPU][4] __attribute__((aligned(16)));
+
+/* hart 0 初始化完成后置 1，其余 hart 在 sstart 中等待 */
+static volatile int smp_started;
+static volatile int smp_online;
+
 static void setup_pmp(void) {
   /* 允许 S/U 模式访问整个物理地址空间：使用 NAPOT 全开 */
   w_pmpaddr0(~0ULL >> 2);
@@ -65,24 +76,52 @@ static void setup_timer_mmio(void) {
   *mtimecmp = now + interval;
 }
 
+/* kmain 在全局数据结构建好之后调用，放行其余 hart 进入调度器 */
+void start_other_harts(void) {
+  __sync_synchronize();
+  smp_started = 1;
+}
+
+int ncpu_online(void) { return smp_online; }
+
 static void sstart(void) {
-  uart_init();
-  trap_init();
-  kmain();
+  __sync_fetch_and_add(&smp_online, 1);
+  if (cpuid() == 0) {
+    uart_init();
+    trap_init();
+    kmain();
+  } else {
+    while (!smp_started) {
+    }
+    __sync_synchronize();
+    kvminithart();
+    kvm_hart_online();
+    trap_inithart();
+    scheduler();
+  }
   while (1) {
     asm volatile("wfi");
   }
 }
 
+/* 每个 hart 都从 entry.S 进入这里，在 M 模式下各自设置本 hart 的 CSR 与时钟 */
 void start(void) {
+  int hart = (int)r_mhartid();
   /* Use machine-mode timer vector to forward timer interrupts to S-mode */
+  w_mscratch((uint64_t)&timer_scratch[hart][4]);
   w_mtvec((uint64_t)timervec);
   w_stvec((uint64_t)kernelvec);
 
   delegate_traps();
   setup_pmp();
-  /* 允许 S 模式读取 time 计数器（mcounteren 的 TM 位） */
-  w_mcounteren(r_mcounteren() | (1UL << 1));
+  /* 允许 S 模式读取 cycle/time 计数器（mcounteren 的 CY、TM 位） */
+  w_mcounteren(r_mcounteren() | (1UL << 0) | (1UL << 1));
+  /* 探测 Zicboz（同时允许 S 模式执行 cbo.zero），决定 PMM 的页清零方式；bss 已在 entry.S 清零 */
+  static uint8_t cbo_probe_buf[NCPU][CBO_PROBE_MAX] __attribute__((aligned(CBO_PROBE_MAX)));
+  int cbo = zicboz_probe(cbo_probe_buf[hart]);
+  if (hart == 0) {
+    pmm_set_cbo_block(cbo);
+  }
   w_satp(0);
   w_mie(r_mie() | MIE_MSIE | MIE_MTIE | MIE_MEIE | MIE_SSIE | MIE_STIE | MIE_SEIE);
   w_sie(r_sie() | SIE_STIE | SIE_SSIE | SIE_SEIE);
@@ -94,12 +133,16 @@ void start(void) {
   mstatus |= MSTATUS_MPP_S;
   mstatus |= MSTATUS_MPIE;
   mstatus &= ~MSTATUS_MIE;
+  /* 硬件有 V 扩展时打开 mstatus.VS，供 MEM_MARCH=rv64gcv 构建的 mem.c 使用 */
+  if (r_misa() & MISA_V) mstatus |= MSTATUS_VS_INIT;
   w_mstatus(mstatus);
 
-  uart_init();
-  uart_puts("Booting into S-mode...\n");
-  uart_puts(" mstatus=");
-  uart_put_hex(r_mstatus());
+  if (hart == 0) {
+    uart_init();
+    uart_puts("Booting into S-mode...\n");
+    uart_puts(" mstatus=");
+    uart_put_hex(r_mstatus());
+  }
 
   w_mepc((uint64_t)sstart);
   asm volatile("mret");
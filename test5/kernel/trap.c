@@ -1,11 +1,17 @@
 // kernel/trap.c
 #include "riscv.h"
 #include "trap.h"
+#include "vm.h"
+#include "kstack.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 
 #define MAX_IRQ 64
+#define TRAP_STACK_SIZE 4096
+
+// kernelvec 的每 hart 暂存区：顶部几个槽位暂存 t0 与陷入 CSR，其余是缺页栈
+static uint8_t trap_stack[NCPU][TRAP_STACK_SIZE] __attribute__((aligned(16)));
 
 static interrupt_handler_t ivt[MAX_IRQ];
 static volatile uint64_t ticks = 0;
@@ -129,16 +135,21 @@ uint64_t get_time(void) { return r_time(); }
 static void set_next_timer(void) {
   const uint64_t now = get_time();
   const uint64_t next = now + TICK_CYCLES;
-  /* 单核：使用 hart=0，避免在 S 模式读取 mhartid 触发非法指令 */
-  volatile uint64_t *mtimecmp = (volatile uint64_t *)CLINT_MTIMECMP(0);
+  /* S 模式不能读 mhartid，用 tp 中的 hart id */
+  volatile uint64_t *mtimecmp = (volatile uint64_t *)CLINT_MTIMECMP(cpuid());
   *mtimecmp = next;
 }
 
+// 每个 hart 都有自己的时钟中断；全局时间只由 hart 0 推进
 void timer_interrupt(void) {
-  ++ticks;
-  ++kernel_ticks;
-  if (counter_ptr) {
-    ++(*counter_ptr);
+  kvm_tlb_ack();  // 应答内核映射撤销的 TLB 击落
+
+  if (cpuid() == 0) {
+    ++ticks;
+    ++kernel_ticks;
+    if (counter_ptr) {
+      ++(*counter_ptr);
+    }
   }
 
   if (should_yield()) {
@@ -174,15 +185,21 @@ void trap_init(void) {
   ticks = 0;
   interrupt_count = 0;
 
+  register_interrupt(SCAUSE_SUPERVISOR_TIMER, timer_interrupt);
+  /* 同时支持软件中断路径（M 模式 timervec 置位 SSIP 时可用） */
+  register_interrupt(SCAUSE_SUPERVISOR_SOFTWARE, software_interrupt);
+  trap_inithart();
+}
+
+void trap_inithart(void) {
+  intr_off();
   w_sip(r_sip() & ~(SIP_SSIP | SIP_STIP | SIP_SEIP));
+  w_sscratch((uint64_t)(trap_stack[cpuid()] + TRAP_STACK_SIZE));
   w_stvec((uint64_t)kernelvec);
 
-  register_interrupt(SCAUSE_SUPERVISOR_TIMER, timer_interrupt);
   enable_interrupt(SCAUSE_SUPERVISOR_TIMER);
-  /* 同时支持软件中断路径（M 模式 timervec 置位 SSIP 时可用） */
-  register_interrupt(SCAUSE_SUPERVISOR_SOFTWARE, software_interrupt);
   enable_interrupt(SCAUSE_SUPERVISOR_SOFTWARE);
-  /* 安排第一次时钟中断 */
+  /* 安排本 hart 的第一次时钟中断 */
   set_next_timer();
   intr_on();
 }
@@ -198,11 +215,9 @@ int devintr(struct trapframe *tf) {
   return 0;
 }
 
+// kernelvec has already stored sepc/sstatus/stval/scause in the frame: a
+// stack-growth fault while the frame was pushed clobbers the CSRs.
 void kerneltrap(struct trapframe *tf) {
-  tf->sepc = r_sepc();
-  tf->sstatus = r_sstatus();
-  tf->stval = r_stval();
-  tf->scause = r_scause();
   tf->reserved = 0;
 
   if (tf->sstatus & SSTATUS_SIE) {
@@ -218,7 +233,9 @@ void kerneltrap(struct trapframe *tf) {
     handle_exception(tf);
   }
 
+  // yield 之后回到这里时 CSR 已被其他陷入改写
   w_sepc(tf->sepc);
+  w_sstatus(tf->sstatus);
 }
 
 void usertrap(struct trapframe *tf) {
@@ -258,6 +275,26 @@ static void handle_store_access_fault(struct trapframe *tf) {
   advance_sepc(tf, 4);
 }
 
+// 内核栈增长或按需分配的第一次读：映射一页清零页后返回，重新执行该 load
+static void handle_load_page_fault(struct trapframe *tf) {
+  if (kstack_fault(tf->stval) == 0 || vm_fault(tf->stval, 0) == 0) {
+    return;
+  }
+  printf("Load page fault at sepc=%#lx addr=%#lx\n",
+         (unsigned long)tf->sepc, (unsigned long)tf->stval);
+  advance_sepc(tf, 4);
+}
+
+// 内核栈增长、写时复制页或按需分配页的第一次写：处理后返回，重新执行该 store
+static void handle_store_page_fault(struct trapframe *tf) {
+  if (kstack_fault(tf->stval) == 0 || vm_fault(tf->stval, 1) == 0) {
+    return;
+  }
+  printf("Store page fault at sepc=%#lx addr=%#lx\n",
+         (unsigned long)tf->sepc, (unsigned long)tf->stval);
+  advance_sepc(tf, 4);
+}
+
 void handle_exception(struct trapframe *tf) {
   const uint64_t cause = SCAUSE_CODE(tf->scause);
   switch (cause) {
@@ -278,10 +315,10 @@ void handle_exception(struct trapframe *tf) {
       handle_illegal_instruction(tf);
       break;
     case 13: // load page fault
-      handle_load_access_fault(tf);
+      handle_load_page_fault(tf);
       break;
     case 15: // store page fault
-      handle_store_access_fault(tf);
+      handle_store_page_fault(tf);
       break;
     default:
       printf("Unhandled exception: scause=%lu sepc=%#lx stval=%#lx\n",
@@ -47,7 +47,8 @@ struct trapframe {
   uint64_t reserved;  // keeps the structure 16-byte aligned
 };
 
-void trap_init(void);
+void trap_init(void);      // hart 0: global trap state, then trap_inithart
+void trap_inithart(void);  // per hart: vectors, scratch area, first timer
 void register_interrupt(int irq, interrupt_handler_t handler);
 void unregister_interrupt(int irq);
 void enable_interrupt(int irq);
@@ -0,0 +1,756 @@
+// kernel/vm.c - 地址空间复制与写时复制（COW）
+//
+// uvm_copy 只复制页表页：用户页（PTE_U 且属于 PMM）在父子之间共享，
+// 可写页在两边都去掉 W、打上 PTE_COW，并给物理页加一个引用。
+// 复制代价与页表大小成正比，与常驻内存大小无关。
+//
+// 第一次写共享页时触发 store page fault（scause 15），由 cow_fault 处理：
+// 引用数大于 1 时复制一份私有页，等于 1 时说明其他共享者都已离开，
+// 直接恢复 W 位，不再复制。
+//
+// 按需分配：mm_mmap 只登记一个 VMA，不分配物理页；第一次访问时
+// load/store page fault（scause 13/15）进入 vm_fault，分配一页清零页
+// （通常直接取自预清零池）并映射。带 VMA_PREFAULT 的区域在 mmap 时一次性填好。
+//
+// ASID：每个地址空间在切换时才分配 ASID，satp 带上 ASID 后切换无需刷新 TLB。
+// ASID 用完时代数（generation）加一并整体刷新一次 TLB，之后所有 mm
+// 在下次切换时重新领取 ASID。ASID 0 保留给内核页表；内核映射带 PTE_G，
+// 按 ASID 刷新不会清掉它们。
+//
+// 内核子表共享：用户窗口 [UVM_BASE, UVM_TOP) 之外的根表项都属于内核，
+// 新根表只复制这些根表项，直接指向内核自己的 L1 页表，建一个地址空间
+// 只需一页。根以下的改动天然对所有地址空间可见；根表项本身的增删
+// 由 kvm_map/kvm_unmap 同步到 mm_list 上的每个根表。
+#include "vm.h"
+#include "kvminit.h"
+#include "pmm.h"
+#include "proc.h"
+#include "riscv.h"
+#include "slab.h"
+#include <stddef.h>
+#include <stdio.h>
+
+#define NPTE 512
+
+static struct {
+  uint64_t tables_copied;  // uvm_copy 复制的页表页
+  uint64_t pages_shared;   // uvm_copy 共享的用户页
+  uint64_t faults;         // COW 缺页次数
+  uint64_t copies;         // 复制了私有页
+  uint64_t reuses;         // 只剩一个引用，直接恢复写权限
+  uint64_t demand_faults;  // 按需分配的页
+  uint64_t prefaulted;     // VMA_PREFAULT 预先填充的页
+  uint64_t switches;       // mm_switch 次数
+  uint64_t asid_allocs;    // 领取新 ASID 的次数
+  uint64_t rollovers;      // ASID 用完、整体刷新 TLB 的次数
+  uint64_t stale_flushes;  // 切换时发现别的 hart 改过该 mm，按 ASID 刷新
+  uint64_t root_syncs;     // 同步到各地址空间的内核根表项
+  uint64_t shootdowns;     // 撤销内核映射后等所有 hart 刷新的次数
+  uint64_t ktlb_flushes;   // 各 hart 为此做的整体刷新
+} vm_stats;
+
+static struct kmem_cache *mm_cache;
+static struct kmem_cache *vma_cache;
+static struct mm *cur_mm[NCPU]; // 每 hart 当前地址空间，NULL 表示内核页表
+static struct mm *mm_list;     // 所有存活的 mm，内核根表项变化时逐个同步
+static struct spinlock mm_list_lock;
+// 内核页表的每次修改连同随后的 kvm_sync 都在 kpt_lock 下进行，否则两个
+// hart 同时补同一个缺失的子表时，其中一个子表连同映射会丢失。
+// 锁顺序：kpt_lock -> mm_list_lock
+static struct spinlock kpt_lock;
+
+// 内核 TLB 击落。内核叶子带 PTE_G，切换地址空间、按 ASID 刷新、ASID 翻代
+// 都清不掉它们，撤销后只能靠每个 hart 自己刷新。ktlb_gen 在每次撤销后加一；
+// 各 hart 在时钟中断、调度循环和 mm_switch 中发现 ktlb_seen 落后就
+// sfence.vma zero, zero 并登记。撤销者等 ktlb_harts 中每个 hart 都登记之后，
+// 才释放页表页、数据页，并把虚拟地址交还给调用者
+static uint64_t ktlb_gen;
+static uint64_t ktlb_seen[NCPU];
+static uint64_t ktlb_harts;    // 已装上内核页表、参与应答的 hart
+
+static int vma_copy_list(struct mm *dst, struct mm *src);
+
+static int asid_bits;          // 硬件实现的 ASID 位数（0 表示不支持）
+static uint16_t asid_max;      // 最大可用 ASID
+static uint64_t asid_gen = 1;  // 当前代数；mm->asid_gen == 0 表示从未分配
+static uint32_t asid_next = 1; // 本代下一个空闲 ASID（0 保留给内核）
+static uint64_t asid_flushed[NCPU]; // 各 hart 已为哪一代整体刷新过 TLB
+static struct spinlock asid_lock;
+
+static inline void sfence_vma_asid(uint64_t va, uint16_t asid) {
+  asm volatile("sfence.vma %0, %1" :: "r"(va), "r"((uint64_t)asid) : "memory");
+}
+
+static inline void sfence_vma_asid_all(uint16_t asid) {
+  asm volatile("sfence.vma zero, %0" :: "r"((uint64_t)asid) : "memory");
+}
+
+static inline int pte_is_leaf(pte_t pte) {
+  return (pte & (PTE_R | PTE_W | PTE_X)) != 0;
+}
+
+// 用户窗口之外的根表项都属于内核
+static inline int kernel_slot(int i) {
+  return i < (int)VPN_MASK(UVM_BASE, PT_ROOT_LEVEL) ||
+         i > (int)VPN_MASK(UVM_TOP - 1, PT_ROOT_LEVEL);
+}
+
+// 把内核根表项复制到 root，返回改动的表项数
+static int copy_kernel_slots(pagetable_t root) {
+  int changed = 0;
+  for (int i = 0; i < NPTE; ++i) {
+    if (kernel_slot(i) && root[i] != kernel_pagetable[i]) {
+      root[i] = kernel_pagetable[i];
+      changed++;
+    }
+  }
+  return changed;
+}
+
+// 按 64 位字复制一页。在缺页路径上，不能改用 memcpy（见 mem.c 开头）
+static void copy_page(void *dst, const void *src) {
+  uint64_t *d = (uint64_t *)dst;
+  const uint64_t *s = (const uint64_t *)src;
+  for (uint64_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); ++i) {
+    d[i] = s[i];
+  }
+}
+
+// 递归复制一级页表；dst 中的每个叶子在写入前已经拿到引用，
+// 中途失败时 uvm_free(dst) 可以正确回收。根表的内核表项已由 uvm_create 填好
+static int copy_level(pagetable_t src, pagetable_t dst, int level) {
+  for (int i = 0; i < NPTE; ++i) {
+    pte_t pte = src[i];
+    if (!(pte & PTE_V) || (level == PT_ROOT_LEVEL && kernel_slot(i))) {
+      continue;
+    }
+    if (level > 0 && !pte_is_leaf(pte)) {
+      pagetable_t child = (pagetable_t)alloc_pagetable_page();
+      if (!child) {
+        return -1;
+      }
+      vm_stats.tables_copied++;
+      dst[i] = PA2PTE(child) | PTE_V;
+      if (copy_level((pagetable_t)PTE2PA(pte), child, level - 1) < 0) {
+        return -1;
+      }
+      continue;
+    }
+    if ((pte & PTE_U) && pmm_managed(PTE2PA(pte))) {
+      if (pte & PTE_W) {
+        pte = (pte & ~PTE_W) | PTE_COW;
+        src[i] = pte;
+      }
+      page_ref_inc((void *)PTE2PA(pte));
+      vm_stats.pages_shared++;
+    }
+    dst[i] = pte;
+  }
+  return 0;
+}
+
+// uvm_create: empty address space. Only the root page is allocated; the
+// kernel root slots point at the kernel's own subtrees.
+pagetable_t uvm_create(void) {
+  pagetable_t pt = (pagetable_t)alloc_pagetable_page();
+  if (pt) {
+    copy_kernel_slots(pt);
+  }
+  return pt;
+}
+
+// uvm_copy: duplicate a page table. User page-table pages are copied, user
+// pages are shared copy-on-write, kernel subtrees are shared as they are.
+// The caller flushes src's stale writable TLB entries. Returns NULL when
+// out of memory.
+pagetable_t uvm_copy(pagetable_t src) {
+  if (!src) {
+    return NULL;
+  }
+  pagetable_t dst = uvm_create();
+  if (!dst) {
+    return NULL;
+  }
+  vm_stats.tables_copied++;
+  if (copy_level(src, dst, PT_ROOT_LEVEL) < 0) {
+    uvm_free(dst);
+    return NULL;
+  }
+  return dst;
+}
+
+
+// 清空一级页表；清空后的子表加入批次，由 uvm_free 一次归还页表页池
+static void free_level(pagetable_t table, int level, struct pt_batch *b) {
+  for (int i = 0; i < NPTE; ++i) {
+    pte_t pte = table[i];
+    if (!(pte & PTE_V)) {
+      continue;
+    }
+    table[i] = 0;
+    if (level == PT_ROOT_LEVEL && kernel_slot(i)) {
+      continue;  // 共享的内核子表，只断开引用
+    }
+    if (level > 0 && !pte_is_leaf(pte)) {
+      pagetable_t child = (pagetable_t)PTE2PA(pte);
+      free_level(child, level - 1, b);
+      pt_batch_add(b, child);
+      continue;
+    }
+    // 用户页都以 4K 叶子映射；内核映射不持有引用
+    if (level == 0 && (pte & PTE_U) && pmm_managed(PTE2PA(pte))) {
+      free_page((void *)PTE2PA(pte));
+    }
+  }
+}
+
+// uvm_free: drop every page reference held by pt and free its tables.
+// pt must not be the active page table.
+void uvm_free(pagetable_t pt) {
+  if (!pt) {
+    return;
+  }
+  struct pt_batch b = {0};
+  free_level(pt, PT_ROOT_LEVEL, &b);
+  pt_batch_add(&b, pt);
+  free_pagetable_batch(&b);
+}
+
+// mm_tlb_changed: mm's leaves were downgraded or removed and this hart has
+// flushed them. Other harts flush mm's ASID before they run it again.
+static void mm_tlb_changed(struct mm *mm) {
+  uint64_t s = intr_save();
+  uint64_t gen = __atomic_add_fetch(&mm->tlb_gen, 1, __ATOMIC_RELEASE);
+  mm->tlb_seen[cpuid()] = gen;
+  intr_restore(s);
+}
+
+// cow_fault: resolve a store fault on a PTE_COW page. Returns 0 when the
+// faulting store can be retried, -1 when the fault is not a COW fault
+// (or no memory is left for the private copy).
+int cow_fault(pagetable_t pt, uint64_t va) {
+  if (!pt) {
+    return -1;
+  }
+  pte_t *pte = walk_lookup(pt, PAGE_ROUND_DOWN(va));
+  if (!pte || !(*pte & PTE_V) || !(*pte & PTE_COW)) {
+    return -1;
+  }
+  vm_stats.faults++;
+
+  void *old = (void *)PTE2PA(*pte);
+  uint64_t flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if (page_ref_count(old) == 1) {
+    // 其他共享者都已释放，这一页已经是私有的
+    *pte = PA2PTE(old) | flags;
+    vm_stats.reuses++;
+  } else {
+    void *copy = alloc_page_nozero();
+    if (!copy) {
+      return -1;
+    }
+    copy_page(copy, old);
+    *pte = PA2PTE(copy) | flags;
+    free_page(old);
+    vm_stats.copies++;
+  }
+  // 缺页总发生在当前地址空间：只刷新当前 ASID 下这一页
+  sfence_vma_asid(PAGE_ROUND_DOWN(va), (uint16_t)SATP_ASID(r_satp()));
+  return 0;
+}
+
+pagetable_t current_pagetable(void) {
+  uint64_t satp = r_satp();
+  if (satp == 0) {
+    return NULL;
+  }
+  return (pagetable_t)((satp & SATP_PPN_MASK) << 12);
+}
+
+// asid_probe: write all-ones into satp.ASID and read back which bits stick.
+static void asid_probe(void) {
+  uint64_t old = r_satp();
+  w_satp(MAKE_SATP_ASID(kernel_pagetable, SATP_ASID_MASK));
+  uint64_t asid = SATP_ASID(r_satp());
+  w_satp(old);
+  asid_bits = 0;
+  while (asid & 1) {
+    asid_bits++;
+    asid >>= 1;
+  }
+  asid_max = (uint16_t)((1UL << asid_bits) - 1);
+}
+
+void vm_init(void) {
+  init_lock(&mm_list_lock, "mm_list");
+  init_lock(&asid_lock, "asid");
+  init_lock(&kpt_lock, "kernel_pt");
+  asid_probe();
+  mm_cache = kmem_cache_create("mm", sizeof(struct mm), 0, NULL);
+  vma_cache = kmem_cache_create("vma", sizeof(struct vma), 0, NULL);
+  if (!mm_cache || !vma_cache) {
+    printf("vm_init: cannot create mm/vma caches\n");
+  }
+  struct pt_usage u;
+  pagetable_usage(kernel_pagetable, &u);
+  int slots = 0;
+  for (int i = 0; i < NPTE; ++i) {
+    slots += kernel_slot(i) && (kernel_pagetable[i] & PTE_V);
+  }
+  printf("vm: %d ASID bits, %d kernel root slots shared, %d table pages saved per mm\n",
+         asid_bits, slots, u.tables - 1);
+}
+
+// 内核根表项变化后同步到所有地址空间；根以下的子表本来就是共享的。
+// 调用者持有 kpt_lock
+static void kvm_sync(void) {
+  acquire(&mm_list_lock);
+  for (struct mm *mm = mm_list; mm; mm = mm->next) {
+    vm_stats.root_syncs += copy_kernel_slots(mm->pagetable);
+  }
+  release(&mm_list_lock);
+}
+
+static inline int kvm_in_user(uint64_t va, uint64_t size) {
+  return va < UVM_TOP && va + size > UVM_BASE;
+}
+
+// kvm_map: map [va, va+size) -> [pa, pa+size) into the kernel page table
+// (PTE_G is added) and propagate new root slots to every address space.
+// The user window is off limits.
+int kvm_map(uint64_t va, uint64_t pa, uint64_t size, int perm) {
+  if (kvm_in_user(va, size)) {
+    return -1;
+  }
+  acquire(&kpt_lock);
+  int r = map_region(kernel_pagetable, va, pa, size, perm | PTE_G);
+  kvm_sync();
+  release(&kpt_lock);
+  return r;
+}
+
+// kvm_map_page: map one kernel page. Inside a window set up by
+// kvm_prealloc the root slot is already there and nothing is propagated.
+int kvm_map_page(uint64_t va, uint64_t pa, int perm) {
+  if (kvm_in_user(va, PAGE_SIZE)) {
+    return -1;
+  }
+  acquire(&kpt_lock);
+  pte_t *root = &kernel_pagetable[VPN_MASK(va, PT_ROOT_LEVEL)];
+  pte_t before = *root;
+  int r = map_page(kernel_pagetable, va, pa, perm | PTE_G);
+  if (*root != before) {
+    kvm_sync();
+  }
+  release(&kpt_lock);
+  return r;
+}
+
+// kvm_hart_online: this hart now runs on the kernel page table and takes
+// part in kernel TLB shootdowns. Called once per hart after kvminithart.
+void kvm_hart_online(void) {
+  uint64_t s = intr_save();
+  int me = cpuid();
+  __atomic_fetch_or(&ktlb_harts, 1UL << me, __ATOMIC_SEQ_CST);
+  uint64_t gen = __atomic_load_n(&ktlb_gen, __ATOMIC_SEQ_CST);
+  sfence_vma_all();
+  __atomic_store_n(&ktlb_seen[me], gen, __ATOMIC_RELEASE);
+  intr_restore(s);
+}
+
+// kvm_tlb_ack: flush this hart's TLB if a kernel unmap happened since it
+// last did. Call with interrupts off.
+void kvm_tlb_ack(void) {
+  int me = cpuid();
+  uint64_t gen = __atomic_load_n(&ktlb_gen, __ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&ktlb_seen[me], __ATOMIC_RELAXED) != gen) {
+    sfence_vma_all();
+    __atomic_store_n(&ktlb_seen[me], gen, __ATOMIC_RELEASE);
+    vm_stats.ktlb_flushes++;
+  }
+}
+
+// kvm_shootdown: wait until every online hart has flushed its TLB after
+// the kernel unmaps made so far. The other harts answer from their timer
+// interrupt, so the caller must have interrupts on and hold no spinlock;
+// a hart spinning on a lock the caller held would never answer.
+static void kvm_shootdown(void) {
+  if (!(r_sstatus() & SSTATUS_SIE)) {
+    panic("kvm_shootdown: interrupts off");
+  }
+  uint64_t gen = __atomic_add_fetch(&ktlb_gen, 1, __ATOMIC_SEQ_CST);
+  uint64_t harts = __atomic_load_n(&ktlb_harts, __ATOMIC_SEQ_CST);
+  vm_stats.shootdowns++;
+  for (int i = 0; i < NCPU; ++i) {
+    if (!(harts & (1UL << i))) {
+      continue;
+    }
+    while (__atomic_load_n(&ktlb_seen[i], __ATOMIC_ACQUIRE) < gen) {
+      // 调用者可能在等待中被迁移，所在的 hart 也要应答
+      push_off();
+      kvm_tlb_ack();
+      pop_off();
+      cpu_relax();
+    }
+  }
+}
+
+// kvm_unmap_range: remove [va, va+size) from the kernel page table and,
+// with free_leaves, give the mapped pages back. Other harts may still hold
+// the old translations in their TLBs, and a table emptied here may be a
+// root slot's subtree that other roots still point at. So the emptied
+// tables and the leaf pages are freed only after kvm_sync has cleared the
+// root slots everywhere and every hart has flushed (kvm_shootdown); when
+// this returns the range can be mapped again. Call with interrupts on and
+// no spinlock held.
+int kvm_unmap_range(uint64_t va, uint64_t size, int free_leaves) {
+  if (kvm_in_user(va, size)) {
+    return -1;
+  }
+  struct pt_deferred dead = {0};
+  acquire(&kpt_lock);
+  int r = unmap_range_deferred(kernel_pagetable, va, size, free_leaves, &dead);
+  if (dead.tables.n) {
+    kvm_sync();
+  }
+  release(&kpt_lock);
+  kvm_shootdown();
+  pt_deferred_free(&dead);
+  return r;
+}
+
+// kvm_unmap: remove a kernel mapping without freeing what it maps. Root
+// slots whose subtree became empty are cleared in every address space.
+int kvm_unmap(uint64_t va, uint64_t size) {
+  uint64_t start = PAGE_ROUND_DOWN(va);
+  return kvm_unmap_range(start, PAGE_ROUND_UP(va + size) - start, 0);
+}
+
+// asid_get: return mm's ASID, allocating one in the current generation if
+// needed. On exhaustion start a new generation. Each hart flushes its whole
+// TLB once per generation, before it first uses an ASID of that generation;
+// after that flush no entry tagged with an old-generation number is left
+// on the hart, so the numbers can be handed out again. Call with interrupts
+// off.
+static uint16_t asid_get(struct mm *mm) {
+  if (asid_max == 0) {
+    // 硬件不支持 ASID：全部使用 0，由调用者每次切换整体刷新
+    return 0;
+  }
+  acquire(&asid_lock);
+  if (mm->asid_gen != asid_gen) {
+    if (asid_next > asid_max) {
+      asid_gen++;
+      asid_next = 1;
+      vm_stats.rollovers++;
+    }
+    mm->asid = (uint16_t)asid_next++;
+    mm->asid_gen = asid_gen;
+    vm_stats.asid_allocs++;
+  }
+  uint16_t asid = mm->asid;
+  int flush = asid_flushed[cpuid()] != asid_gen;
+  asid_flushed[cpuid()] = asid_gen;
+  release(&asid_lock);
+  if (flush) {
+    sfence_vma_all();
+  }
+  return asid;
+}
+
+// mm_switch: make mm the active address space of this hart and of the
+// current process (the scheduler reloads it when the process runs again,
+// possibly on another hart). With a valid ASID no TLB flush is needed
+// unless another hart changed mm's leaves since mm last ran here (see
+// tlb_gen in vm.h); kernel mappings are PTE_G and survive anyway.
+void mm_switch(struct mm *mm) {
+  uint64_t s = intr_save();
+  struct proc *p = mycpu()->proc;
+  if (p) {
+    p->mm = mm;
+  }
+  vm_stats.switches++;
+  cur_mm[cpuid()] = mm;
+  if (!mm) {
+    w_satp(MAKE_SATP_ASID(kernel_pagetable, 0));
+  } else {
+    uint16_t asid = asid_get(mm);
+    uint64_t gen = __atomic_load_n(&mm->tlb_gen, __ATOMIC_ACQUIRE);
+    w_satp(MAKE_SATP_ASID(mm->pagetable, asid));
+    if (asid == 0) {
+      sfence_vma_all();
+    } else if (mm->tlb_seen[cpuid()] != gen) {
+      // 该 mm 上次在本 hart 运行之后，别的 hart 降级或解除过它的映射
+      sfence_vma_asid_all(asid);
+      vm_stats.stale_flushes++;
+    }
+    mm->tlb_seen[cpuid()] = gen;
+  }
+  kvm_tlb_ack();
+  intr_restore(s);
+}
+
+// kvm_prealloc: create the page-table pages of a kernel window down to
+// `level` now; PT_ROOT_LEVEL - 1 gives each root slot its level-1 table.
+// Mappings made inside the window later never change a root slot, so no
+// propagation is needed. With level 0 they never allocate a table either,
+// and only write leaf PTEs.
+int kvm_prealloc(uint64_t va, uint64_t size, int level) {
+  if (size == 0 || level < 0 || level >= PT_ROOT_LEVEL || kvm_in_user(va, size)) {
+    return -1;
+  }
+  acquire(&kpt_lock);
+  int r = 0;
+  const uint64_t span = LEVEL_SIZE(level + 1);
+  for (uint64_t a = va & ~(span - 1); a < va + size; a += span) {
+    if (!walk_create_level(kernel_pagetable, a, level)) {
+      r = -1;
+      break;
+    }
+  }
+  kvm_sync();
+  release(&kpt_lock);
+  return r;
+}
+
+// 新 mm 挂到 mm_list 上。加锁后再同步一次内核根表项，
+// 以免漏掉建根表与入链之间的 kvm_map/kvm_unmap
+static struct mm *mm_alloc(pagetable_t pt) {
+  struct mm *mm = kmem_cache_alloc(mm_cache);
+  if (!mm) {
+    return NULL;
+  }
+  mm->pagetable = pt;
+  mm->vmas = NULL;
+  mm->asid = 0;
+  mm->asid_gen = 0;
+  mm->tlb_gen = 0;
+  for (int i = 0; i < NCPU; ++i) {
+    mm->tlb_seen[i] = 0;
+  }
+  acquire(&mm_list_lock);
+  if (pt) {
+    copy_kernel_slots(pt);
+  }
+  mm->next = mm_list;
+  mm_list = mm;
+  release(&mm_list_lock);
+  return mm;
+}
+
+static void mm_unlink(struct mm *mm) {
+  acquire(&mm_list_lock);
+  for (struct mm **pp = &mm_list; *pp; pp = &(*pp)->next) {
+    if (*pp == mm) {
+      *pp = mm->next;
+      break;
+    }
+  }
+  release(&mm_list_lock);
+}
+
+// mm_create: new address space containing only the kernel mappings.
+// Costs one root page however large the kernel mappings are.
+struct mm *mm_create(void) {
+  pagetable_t pt = uvm_create();
+  if (!pt) {
+    return NULL;
+  }
+  struct mm *mm = mm_alloc(pt);
+  if (!mm) {
+    uvm_free(pt);
+  }
+  return mm;
+}
+
+// mm_copy: fork-style copy. User pages become COW in both address spaces.
+struct mm *mm_copy(struct mm *src) {
+  pagetable_t pt = uvm_copy(src->pagetable);
+  struct mm *mm = mm_alloc(pt);
+  if (!mm) {
+    uvm_free(pt);
+    return NULL;
+  }
+  // src 的可写叶子可能刚被改成只读：只需作废 src 自己 ASID 下的 TLB 项
+  if (src->asid_gen == asid_gen && src->asid != 0) {
+    sfence_vma_asid_all(src->asid);
+  } else {
+    sfence_vma_all();
+  }
+  mm_tlb_changed(src);
+  if (!mm->pagetable || vma_copy_list(mm, src) < 0) {
+    mm_free(mm);
+    return NULL;
+  }
+  return mm;
+}
+
+// mm_free: release an address space that is not active on any hart. Its
+// ASID is not reused before the next rollover, which flushes the TLB, so
+// stale entries tagged with it are harmless.
+void mm_free(struct mm *mm) {
+  if (!mm) {
+    return;
+  }
+  mm_unlink(mm);
+  while (mm->vmas) {
+    struct vma *v = mm->vmas;
+    mm->vmas = v->next;
+    kmem_cache_free(vma_cache, v);
+  }
+  uvm_free(mm->pagetable);
+  kmem_cache_free(mm_cache, mm);
+}
+
+struct mm *current_mm(void) {
+  uint64_t s = intr_save();
+  struct mm *mm = cur_mm[cpuid()];
+  intr_restore(s);
+  return mm;
+}
+
+// vma_find: VMA containing va, or NULL.
+struct vma *vma_find(struct mm *mm, uint64_t va) {
+  for (struct vma *v = mm ? mm->vmas : NULL; v && v->start <= va; v = v->next) {
+    if (va < v->end) {
+      return v;
+    }
+  }
+  return NULL;
+}
+
+// 子进程的 VMA 列表逐项复制，保持有序
+static int vma_copy_list(struct mm *dst, struct mm *src) {
+  struct vma **tail = &dst->vmas;
+  for (struct vma *v = src->vmas; v; v = v->next) {
+    struct vma *n = kmem_cache_alloc(vma_cache);
+    if (!n) {
+      return -1;
+    }
+    *n = *v;
+    n->next = NULL;
+    *tail = n;
+    tail = &n->next;
+  }
+  return 0;
+}
+
+// 分配一页清零页映射到 va（已映射时直接成功）
+static int populate_page(struct mm *mm, struct vma *v, uint64_t va) {
+  pte_t *pte = walk_lookup(mm->pagetable, va);
+  if (pte && (*pte & PTE_V)) {
+    return 0;
+  }
+  void *page = alloc_page();
+  if (!page) {
+    return -1;
+  }
+  if (map_page(mm->pagetable, va, (uint64_t)page, v->perm | PTE_U) != 0) {
+    free_page(page);
+    return -1;
+  }
+  return 0;
+}
+
+// mm_mmap: reserve [va, va+len) as anonymous zero-filled memory. Nothing
+// is allocated unless flags has VMA_PREFAULT. Fails on overlap.
+int mm_mmap(struct mm *mm, uint64_t va, uint64_t len, int perm, int flags) {
+  uint64_t start = PAGE_ROUND_DOWN(va);
+  uint64_t end = PAGE_ROUND_UP(va + len);
+  if (!mm || end <= start || !(perm & (PTE_R | PTE_W | PTE_X)) ||
+      start < UVM_BASE || end > UVM_TOP) {
+    return -1;
+  }
+  struct vma **pp = &mm->vmas;
+  while (*pp && (*pp)->end <= start) {
+    pp = &(*pp)->next;
+  }
+  if (*pp && (*pp)->start < end) {
+    return -1;  // 与已有 VMA 重叠
+  }
+
+  struct vma *v = kmem_cache_alloc(vma_cache);
+  if (!v) {
+    return -1;
+  }
+  v->start = start;
+  v->end = end;
+  v->perm = perm & (PTE_R | PTE_W | PTE_X);
+  v->flags = flags;
+  v->next = *pp;
+  *pp = v;
+
+  if (flags & VMA_PREFAULT) {
+    for (uint64_t a = start; a < end; a += PAGE_SIZE) {
+      if (populate_page(mm, v, a) < 0) {
+        mm_munmap(mm, start, end - start);
+        return -1;
+      }
+      vm_stats.prefaulted++;
+    }
+  }
+  return 0;
+}
+
+// mm_munmap: remove the VMA that exactly covers [va, va+len) and free the
+// pages that were populated in it.
+int mm_munmap(struct mm *mm, uint64_t va, uint64_t len) {
+  uint64_t start = PAGE_ROUND_DOWN(va);
+  uint64_t end = PAGE_ROUND_UP(va + len);
+  for (struct vma **pp = mm ? &mm->vmas : NULL; pp && *pp; pp = &(*pp)->next) {
+    struct vma *v = *pp;
+    if (v->start == start && v->end == end) {
+      *pp = v->next;
+      kmem_cache_free(vma_cache, v);
+      // 只有 4K 叶子，不会触发大页拆分；本 hart 的 TLB 由 unmap_range 统一刷新
+      int r = unmap_range(mm->pagetable, start, end - start, 1);
+      mm_tlb_changed(mm);
+      return r;
+    }
+  }
+  return -1;
+}
+
+// vm_fault: page-fault path for the current address space. Store faults on
+// COW pages are resolved first; otherwise a fault inside a VMA whose
+// permissions allow the access gets a freshly zeroed page. Returns 0 when
+// the faulting instruction can be retried.
+int vm_fault(uint64_t va, int is_store) {
+  struct mm *mm = cur_mm[cpuid()];  // 陷入处理中，中断已关
+  if (!mm) {
+    return -1;
+  }
+  if (is_store && cow_fault(mm->pagetable, va) == 0) {
+    mm_tlb_changed(mm);
+    return 0;
+  }
+  struct vma *v = vma_find(mm, va);
+  if (!v || !(v->perm & (is_store ? PTE_W : PTE_R))) {
+    return -1;
+  }
+  pte_t *pte = walk_lookup(mm->pagetable, PAGE_ROUND_DOWN(va));
+  if (pte && (*pte & PTE_V)) {
+    return -1;  // 已映射仍然缺页：真正的权限错误
+  }
+  if (populate_page(mm, v, PAGE_ROUND_DOWN(va)) < 0) {
+    return -1;
+  }
+  // 无效 -> 有效不需要刷新 TLB
+  vm_stats.demand_faults++;
+  return 0;
+}
+
+void vm_dump_stats(void) {
+  printf("vm: tables copied=%lu pages shared=%lu cow faults=%lu copies=%lu reuses=%lu\n",
+         (unsigned long)vm_stats.tables_copied, (unsigned long)vm_stats.pages_shared,
+         (unsigned long)vm_stats.faults, (unsigned long)vm_stats.copies,
+         (unsigned long)vm_stats.reuses);
+  printf("vm: demand faults=%lu prefaulted=%lu\n", (unsigned long)vm_stats.demand_faults,
+         (unsigned long)vm_stats.prefaulted);
+  printf("vm: asid bits=%d switches=%lu asid allocs=%lu rollovers=%lu stale flushes=%lu\n",
+         asid_bits, (unsigned long)vm_stats.switches, (unsigned long)vm_stats.asid_allocs,
+         (unsigned long)vm_stats.rollovers, (unsigned long)vm_stats.stale_flushes);
+  printf("vm: kernel root slots synced=%lu shootdowns=%lu kernel tlb flushes=%lu\n",
+         (unsigned long)vm_stats.root_syncs, (unsigned long)vm_stats.shootdowns,
+         (unsigned long)vm_stats.ktlb_flushes);
+}
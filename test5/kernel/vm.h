@@ -0,0 +1,89 @@
+// kernel/vm.h
+#pragma once
+
+#include <stdint.h>
+#include "pagetable.h"
+#include "riscv.h"
+
+// Address spaces are page tables that contain the kernel mappings plus
+// PTE_U leaves owned by the address space. Leaves that point into PMM
+// memory hold one page reference each.
+//
+// User regions are described by a sorted list of VMAs. Pages inside a VMA
+// are allocated on first touch by the page-fault path unless the VMA was
+// created with VMA_PREFAULT.
+//
+// Kernel subtrees are shared: every root table points at the kernel's
+// own level-1 tables, so a new address space costs one page. User mappings
+// are confined to [UVM_BASE, UVM_TOP), whose root slots the kernel never
+// uses; all other root slots belong to the kernel. Kernel mappings added
+// after boot must go through the kvm_* calls, which serialise changes to
+// the kernel page table and copy root slots that appear or disappear
+// into every live address space.
+// Kernel leaves are PTE_G, so kvm_unmap_range also waits until every
+// hart has flushed its TLB before the pages and the range can be reused.
+//
+// Each mm is tagged with an ASID so that switching between address spaces
+// does not flush the TLB. ASIDs are handed out lazily at switch time; the
+// generation tells whether an mm's ASID is still valid after a rollover.
+//
+// A hart that downgrades or removes an mm's leaves (COW, mm_copy, munmap)
+// only flushes its own TLB, and harts keep entries tagged with the ASID
+// after they stop running the mm. tlb_gen counts those changes and
+// tlb_seen[hart] records the count each hart's TLB is current for;
+// mm_switch flushes the ASID on a hart that is behind. An mm is changed by
+// one hart at a time (its process, or the creator before it runs).
+// The window is root slot 1 in either paging mode.
+#ifdef PT_SV48
+#define UVM_BASE 0x8000000000UL    // user VA window: 512GB-1TB
+#define UVM_TOP  0x10000000000UL
+#else
+#define UVM_BASE 0x40000000UL      // user VA window: 1GB-2GB
+#define UVM_TOP  0x80000000UL
+#endif
+
+#define VMA_PREFAULT 0x1   // populate the whole region at mmap time
+
+struct vma {
+  uint64_t start;      // page aligned
+  uint64_t end;        // exclusive, page aligned
+  int perm;            // PTE_R/W/X; PTE_U is added when mapping
+  int flags;
+  struct vma *next;    // sorted by start
+};
+
+struct mm {
+  pagetable_t pagetable;
+  struct vma *vmas;
+  uint64_t asid_gen;   // generation the ASID below belongs to
+  uint16_t asid;
+  uint64_t tlb_gen;            // leaf downgrades/removals so far
+  uint64_t tlb_seen[NCPU];     // tlb_gen each hart's TLB has caught up with
+  struct mm *next;     // all live mms, for kernel root-slot propagation
+};
+
+void            vm_init(void);
+struct mm      *mm_create(void);
+struct mm      *mm_copy(struct mm *src);
+void            mm_free(struct mm *mm);
+void            mm_switch(struct mm *mm);   // NULL = kernel page table
+struct mm      *current_mm(void);
+int             mm_mmap(struct mm *mm, uint64_t va, uint64_t len, int perm, int flags);
+int             mm_munmap(struct mm *mm, uint64_t va, uint64_t len);
+struct vma     *vma_find(struct mm *mm, uint64_t va);
+int             vm_fault(uint64_t va, int is_store);
+
+int             kvm_map(uint64_t va, uint64_t pa, uint64_t size, int perm);
+int             kvm_unmap(uint64_t va, uint64_t size);
+int             kvm_map_page(uint64_t va, uint64_t pa, int perm);
+int             kvm_unmap_range(uint64_t va, uint64_t size, int free_leaves);
+int             kvm_prealloc(uint64_t va, uint64_t size, int level);
+void            kvm_hart_online(void);
+void            kvm_tlb_ack(void);
+
+pagetable_t     uvm_create(void);
+pagetable_t     uvm_copy(pagetable_t src);
+void            uvm_free(pagetable_t pt);
+int             cow_fault(pagetable_t pt, uint64_t va);
+pagetable_t     current_pagetable(void);
+void            vm_dump_stats(void);
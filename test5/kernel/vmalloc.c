@@ -0,0 +1,183 @@
+// kernel/vmalloc.c - 虚拟连续的内核大块内存
+//
+// vmalloc 在内核 VA 窗口 [VMALLOC_BASE, VMALLOC_END) 中找一段空闲虚拟地址，
+// 逐页从 PMM 取单页映射进去，物理上不要求连续，碎片化时也能成功。
+// 每个分配前后各留一页不映射的保护页：越界访问立即缺页，
+// 而不是悄悄踩坏相邻的分配。
+//
+// 窗口的 L1 页表在 vmalloc_init 时由 kvm_prealloc 建好，之后的映射只改动
+// 根以下的共享子表，自动对所有地址空间可见，不需要同步根表项。
+// 映射和撤销经 kvm_map_page/kvm_unmap_range 在内核页表锁下进行，
+// 多个 hart 同时 vmalloc 时不会争着补同一个 L0 页表。
+//
+// 已占用的虚拟区间（含保护页）记录在按地址排序的 vmap_area 链表上，
+// 分配时首次适配查找空洞。
+#include "vmalloc.h"
+#include "kvminit.h"
+#include "pagetable.h"
+#include "pmm.h"
+#include "riscv.h"
+#include "slab.h"
+#include "spinlock.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdio.h>
+
+struct vmap_area {
+  uint64_t start;          // 头保护页
+  uint64_t end;            // 尾保护页之后（不含）
+  struct vmap_area *next;  // 按 start 排序
+  int freeing;             // vfree 正在撤销映射，区间仍占着窗口
+};
+
+static struct kmem_cache *vmap_cache;
+static struct vmap_area *vmap_list;
+static struct spinlock vmap_lock;
+
+static struct {
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t failures;
+  uint64_t pages;  // 当前映射的页数
+} vmalloc_stats;
+
+static inline uint64_t area_bytes(struct vmap_area *a) {
+  return a->end - a->start - 2 * PAGE_SIZE;
+}
+
+void vmalloc_init(void) {
+  init_lock(&vmap_lock, "vmap");
+  vmap_cache = kmem_cache_create("vmap_area", sizeof(struct vmap_area), 0, NULL);
+  if (!vmap_cache || kvm_prealloc(VMALLOC_BASE, VMALLOC_SIZE, PT_ROOT_LEVEL - 1) < 0) {
+    printf("vmalloc_init: failed\n");
+    vmap_cache = NULL;
+    return;
+  }
+  printf("vmalloc: window %#lx-%#lx\n", VMALLOC_BASE, VMALLOC_END);
+}
+
+// 首次适配保留 span 字节的虚拟区间
+static struct vmap_area *vmap_reserve(uint64_t span) {
+  struct vmap_area *a = kmem_cache_alloc(vmap_cache);
+  if (!a) {
+    return NULL;
+  }
+  acquire(&vmap_lock);
+  uint64_t start = VMALLOC_BASE;
+  struct vmap_area **pp = &vmap_list;
+  while (*pp && (*pp)->start - start < span) {
+    start = (*pp)->end;
+    pp = &(*pp)->next;
+  }
+  if (VMALLOC_END - start < span) {
+    release(&vmap_lock);
+    kmem_cache_free(vmap_cache, a);
+    return NULL;
+  }
+  a->start = start;
+  a->end = start + span;
+  a->freeing = 0;
+  a->next = *pp;
+  *pp = a;
+  release(&vmap_lock);
+  return a;
+}
+
+// 按用户可见地址找到区间并标记为释放中。区间留在链表上，别的 hart 的
+// TLB 刷新之前这段虚拟地址不会被 vmap_reserve 再分出去
+static struct vmap_area *vmap_claim(uint64_t va) {
+  struct vmap_area *a = NULL;
+  acquire(&vmap_lock);
+  for (struct vmap_area *it = vmap_list; it && it->start < va; it = it->next) {
+    if (it->start + PAGE_SIZE == va) {
+      if (!it->freeing) {
+        it->freeing = 1;
+        a = it;
+      }
+      break;
+    }
+  }
+  release(&vmap_lock);
+  return a;
+}
+
+// 按用户可见地址（头保护页之后）摘下区间
+static struct vmap_area *vmap_remove(uint64_t va) {
+  struct vmap_area *a = NULL;
+  acquire(&vmap_lock);
+  for (struct vmap_area **pp = &vmap_list; *pp && (*pp)->start < va; pp = &(*pp)->next) {
+    if ((*pp)->start + PAGE_SIZE == va) {
+      a = *pp;
+      *pp = a->next;
+      break;
+    }
+  }
+  release(&vmap_lock);
+  return a;
+}
+
+// vmalloc: allocate size bytes (rounded up to pages) of zeroed memory.
+// Returns NULL when the window or physical memory is exhausted.
+void *vmalloc(uint64_t size) {
+  if (size == 0 || !vmap_cache) {
+    return NULL;
+  }
+  uint64_t bytes = PAGE_ROUND_UP(size);
+  struct vmap_area *a = vmap_reserve(bytes + 2 * PAGE_SIZE);
+  if (!a) {
+    vmalloc_stats.failures++;
+    return NULL;
+  }
+  uint64_t va = a->start + PAGE_SIZE;
+  for (uint64_t off = 0; off < bytes; off += PAGE_SIZE) {
+    void *page = alloc_page();
+    if (!page || kvm_map_page(va + off, (uint64_t)page, PTE_R | PTE_W) != 0) {
+      if (page) {
+        free_page(page);
+      }
+      // 已映射的部分连同物理页一起撤销
+      kvm_unmap_range(va, off, 1);
+      vmap_remove(va);
+      kmem_cache_free(vmap_cache, a);
+      vmalloc_stats.failures++;
+      return NULL;
+    }
+  }
+  // 无效 -> 有效不需要刷新 TLB
+  vmalloc_stats.allocs++;
+  vmalloc_stats.pages += bytes / PAGE_SIZE;
+  return (void *)va;
+}
+
+// vfree: unmap and free an area returned by vmalloc. NULL is ignored.
+// Waits for the other harts' TLB flush: call with interrupts on and no
+// spinlock held.
+void vfree(void *addr) {
+  if (!addr) {
+    return;
+  }
+  struct vmap_area *a = vmap_claim((uint64_t)addr);
+  if (!a) {
+    printf("vfree: bad address %p\n", addr);
+    return;
+  }
+  uint64_t bytes = area_bytes(a);
+  // kvm_unmap_range 返回时各 hart 都已刷新 TLB，之后才交还虚拟地址
+  kvm_unmap_range((uint64_t)addr, bytes, 1);
+  vmap_remove((uint64_t)addr);
+  kmem_cache_free(vmap_cache, a);
+  vmalloc_stats.frees++;
+  vmalloc_stats.pages -= bytes / PAGE_SIZE;
+}
+
+void vmalloc_dump(void) {
+  int areas = 0;
+  acquire(&vmap_lock);
+  for (struct vmap_area *a = vmap_list; a; a = a->next) {
+    areas++;
+  }
+  release(&vmap_lock);
+  printf("vmalloc: %d areas, %lu pages mapped, allocs=%lu frees=%lu failures=%lu\n", areas,
+         (unsigned long)vmalloc_stats.pages, (unsigned long)vmalloc_stats.allocs,
+         (unsigned long)vmalloc_stats.frees, (unsigned long)vmalloc_stats.failures);
+}
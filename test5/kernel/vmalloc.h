@@ -0,0 +1,18 @@
+// kernel/vmalloc.h
+#pragma once
+
+#include <stdint.h>
+
+// vmalloc hands out kernel memory that is virtually but not physically
+// contiguous. Pages come one by one from the PMM and are mapped into a
+// dedicated kernel VA window, so large buffers can be allocated even when
+// no contiguous run of physical pages exists. Every allocation is
+// surrounded by unmapped guard pages.
+#define VMALLOC_BASE 0x2000000000UL            // 128GB: root slot 128 under Sv39
+#define VMALLOC_SIZE (1UL << 30)               // 1GB
+#define VMALLOC_END  (VMALLOC_BASE + VMALLOC_SIZE)
+
+void  vmalloc_init(void);
+void *vmalloc(uint64_t size);                  // zeroed, page granular
+void  vfree(void *addr);
+void  vmalloc_dump(void);